@@ -0,0 +1,446 @@
+#include "ClosureCompiler.h"
+
+#include "Interpreter.h"
+#include "Operators.h"
+
+namespace {
+
+// EXPRESSION HANDLERS
+
+Object literal(Interpreter&, Expr& expr) {
+    return static_cast<Literal&>(expr).m_Literal;
+}
+
+Object globalVariable(Interpreter& interpreter, Expr& expr) {
+    auto& variable = static_cast<Variable&>(expr);
+    return interpreter.getGlobals().get(variable.m_GlobalIndex, variable.m_VariableName);
+}
+
+// A global the Resolver never saw, looked up by name.
+Object lateBoundVariable(Interpreter& interpreter, Expr& expr) {
+    return interpreter.getGlobals().lookup(static_cast<Variable&>(expr).m_VariableName);
+}
+
+Object localVariable(Interpreter& interpreter, Expr& expr) {
+    return interpreter.currentEnvironment().get(static_cast<Variable&>(expr).m_Slot);
+}
+
+Object upvalueVariable(Interpreter& interpreter, Expr& expr) {
+    return interpreter.currentEnvironment().upvalue(static_cast<Variable&>(expr).m_Upvalue);
+}
+
+// A local some closure captures, read through its cell.
+Object cellVariable(Interpreter& interpreter, Expr& expr) {
+    return *interpreter.currentEnvironment().cell(static_cast<Variable&>(expr).m_Slot);
+}
+
+const Object& readLocal(Interpreter& interpreter, const Expr& expr) {
+    return interpreter.currentEnvironment().get(static_cast<const Variable&>(expr).m_Slot);
+}
+
+Object grouping(Interpreter& interpreter, Expr& expr) {
+    return interpreter.evaluate(static_cast<Grouping&>(expr).m_Expression.get());
+}
+
+template<TokenType Op>
+Object binary(Interpreter& interpreter, Expr& expr) {
+    auto& binary = static_cast<Binary&>(expr);
+    Object left = interpreter.evaluate(binary.m_Left.get());
+    Object right = interpreter.evaluate(binary.m_Right.get());
+    return operators::binary<Op>(interpreter, binary.m_Operator, left, right);
+}
+
+// `x < 10`, `n - 1`, ...: the right operand is used in place instead of being evaluated and copied.
+template<TokenType Op>
+Object binaryConstant(Interpreter& interpreter, Expr& expr) {
+    auto& binary = static_cast<Binary&>(expr);
+    Object left = interpreter.evaluate(binary.m_Left.get());
+    return operators::binary<Op>(interpreter, binary.m_Operator, left, static_cast<Literal&>(*binary.m_Right).m_Literal);
+}
+
+// `a + b` on two locals: both operands are read straight from their slots, with no evaluation and no copies.
+template<TokenType Op>
+Object binaryLocals(Interpreter& interpreter, Expr& expr) {
+    auto& binary = static_cast<Binary&>(expr);
+    return operators::binary<Op>(interpreter, binary.m_Operator, readLocal(interpreter, *binary.m_Left),
+                                 readLocal(interpreter, *binary.m_Right));
+}
+
+// `i < 10` on a local and a literal.
+template<TokenType Op>
+Object binaryLocalConstant(Interpreter& interpreter, Expr& expr) {
+    auto& binary = static_cast<Binary&>(expr);
+    return operators::binary<Op>(interpreter, binary.m_Operator, readLocal(interpreter, *binary.m_Left),
+                                 static_cast<Literal&>(*binary.m_Right).m_Literal);
+}
+
+bool isLocal(const Expr* expr) {
+    auto variable = dynamic_cast<const Variable*>(expr);
+    return variable != nullptr && variable->m_Slot != -1 && !variable->m_InCell;
+}
+
+template<TokenType Op>
+ExprHandler selectBinary(const Binary& expr) {
+    bool constantRight = dynamic_cast<const Literal*>(expr.m_Right.get()) != nullptr;
+    if (isLocal(expr.m_Left.get())) {
+        if (constantRight) {
+            return binaryLocalConstant<Op>;
+        }
+        if (isLocal(expr.m_Right.get())) {
+            return binaryLocals<Op>;
+        }
+    }
+    if (constantRight) {
+        return binaryConstant<Op>;
+    }
+    return binary<Op>;
+}
+
+template<TokenType Op>
+Object unary(Interpreter& interpreter, Expr& expr) {
+    auto& unary = static_cast<Unary&>(expr);
+    Object right = interpreter.evaluate(unary.m_Right.get());
+    return operators::unary<Op>(interpreter, unary.m_Operator, right);
+}
+
+template<TokenType Op>
+Object logical(Interpreter& interpreter, Expr& expr) {
+    auto& logical = static_cast<Logical&>(expr);
+    Object left = interpreter.evaluate(logical.m_Left.get());
+
+    bool shortCircuits = Op == TOKEN_OR ? interpreter.isTruthy(left) : !interpreter.isTruthy(left);
+    if (shortCircuits) {
+        return left;
+    }
+    return interpreter.evaluate(logical.m_Right.get());
+}
+
+/* The rest call the Interpreter's visit method with a qualified name, which is a direct call instead of a virtual one,
+ * so they still skip accept() and the virtual visit. */
+
+Object call(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitCallExpr(static_cast<Call&>(expr));
+}
+
+Object superCall(Interpreter& interpreter, Expr& expr) {
+    return interpreter.callSuperMethod(static_cast<Call&>(expr));
+}
+
+Object methodCall(Interpreter& interpreter, Expr& expr) {
+    return interpreter.callMethod(static_cast<Call&>(expr));
+}
+
+Object anonFunction(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitAnonFunctionExpr(static_cast<AnonFunction&>(expr));
+}
+
+Object get(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitGetExpr(static_cast<Get&>(expr));
+}
+
+Object set(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitSetExpr(static_cast<Set&>(expr));
+}
+
+Object assign(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitAssignExpr(static_cast<Assign&>(expr));
+}
+
+Object thisExpr(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitThisExpr(static_cast<This&>(expr));
+}
+
+Object superExpr(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitSuperExpr(static_cast<Super&>(expr));
+}
+
+Object ternary(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitTernaryExpr(static_cast<Ternary&>(expr));
+}
+
+Object spawn(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitSpawnExpr(static_cast<Spawn&>(expr));
+}
+
+Object await(Interpreter& interpreter, Expr& expr) {
+    return interpreter.Interpreter::visitAwaitExpr(static_cast<Await&>(expr));
+}
+
+// STATEMENT HANDLERS
+
+void expression(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.evaluate(static_cast<Expression&>(stmt).m_Expression.get());
+}
+
+void returnStmt(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitReturnStmt(static_cast<Return&>(stmt));
+}
+
+void breakStmt(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitBreakStmt(static_cast<Break&>(stmt));
+}
+
+void let(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitLetStmt(static_cast<Let&>(stmt));
+}
+
+void whileStmt(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitWhileStmt(static_cast<While&>(stmt));
+}
+
+void ifStmt(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitIfStmt(static_cast<If&>(stmt));
+}
+
+void block(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitBlockStmt(static_cast<Block&>(stmt));
+}
+
+void function(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitFunctionStmt(static_cast<Function&>(stmt));
+}
+
+void print(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitPrintStmt(static_cast<Print&>(stmt));
+}
+
+void clazz(Interpreter& interpreter, Stmt& stmt) {
+    interpreter.Interpreter::visitClazzStmt(static_cast<Class&>(stmt));
+}
+
+}
+
+ClosureCompiler::ClosureCompiler(Interpreter& interpreter) : m_Interpreter(interpreter) {}
+
+void ClosureCompiler::compile(std::vector<UniqueStmtPtr>& statements) {
+    for (auto& statement : statements) {
+        compile(statement.get());
+    }
+}
+
+void ClosureCompiler::compile(Expr* expr) {
+    if (expr != nullptr) {
+        expr->accept(*this);
+    }
+}
+
+void ClosureCompiler::compile(Stmt* stmt) {
+    if (stmt != nullptr) {
+        stmt->accept(*this);
+    }
+}
+
+// EXPRESSIONS
+
+Object ClosureCompiler::visitSetExpr(Set& expr) {
+    compile(expr.m_Object.get());
+    compile(expr.m_Value.get());
+    expr.m_Handler = set;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitLogicalExpr(Logical& expr) {
+    compile(expr.m_Left.get());
+    compile(expr.m_Right.get());
+    if (expr.m_Operator.type == TOKEN_OR) {
+        expr.m_Handler = logical<TOKEN_OR>;
+    } else {
+        expr.m_Handler = logical<TOKEN_AND>;
+    }
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitLiteralExpr(Literal& expr) {
+    expr.m_Handler = literal;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitGroupingExpr(Grouping& expr) {
+    compile(expr.m_Expression.get());
+    expr.m_Handler = grouping;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitCallExpr(Call& expr) {
+    compile(expr.m_Callee.get());
+    for (auto& argument : expr.m_Arguments) {
+        compile(argument.get());
+    }
+    // Calling `super.method` directly saves binding a copy of the method to "this" just to call it once.
+    if (dynamic_cast<Super*>(expr.m_Callee.get()) != nullptr) {
+        expr.m_Handler = superCall;
+    } else if (dynamic_cast<Get*>(expr.m_Callee.get()) != nullptr) {
+        // Likewise for `object.method(...)`.
+        expr.m_Handler = methodCall;
+    } else {
+        expr.m_Handler = call;
+    }
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitAnonFunctionExpr(AnonFunction& expr) {
+    compile(expr.m_Body);
+    expr.m_Handler = anonFunction;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitGetExpr(Get& expr) {
+    compile(expr.m_Object.get());
+    expr.m_Handler = get;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitAssignExpr(Assign& expr) {
+    compile(expr.m_Value.get());
+    expr.m_Handler = assign;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitBinaryExpr(Binary& expr) {
+    compile(expr.m_Left.get());
+    compile(expr.m_Right.get());
+
+    switch (expr.m_Operator.type) {
+        case TOKEN_MINUS:         expr.m_Handler = selectBinary<TOKEN_MINUS>(expr); break;
+        case TOKEN_SLASH:         expr.m_Handler = selectBinary<TOKEN_SLASH>(expr); break;
+        case TOKEN_STAR:          expr.m_Handler = selectBinary<TOKEN_STAR>(expr); break;
+        case TOKEN_GREATER:       expr.m_Handler = selectBinary<TOKEN_GREATER>(expr); break;
+        case TOKEN_GREATER_EQUAL: expr.m_Handler = selectBinary<TOKEN_GREATER_EQUAL>(expr); break;
+        case TOKEN_LESS:          expr.m_Handler = selectBinary<TOKEN_LESS>(expr); break;
+        case TOKEN_LESS_EQUAL:    expr.m_Handler = selectBinary<TOKEN_LESS_EQUAL>(expr); break;
+        case TOKEN_EQUAL_EQUAL:   expr.m_Handler = selectBinary<TOKEN_EQUAL_EQUAL>(expr); break;
+        case TOKEN_BANG_EQUAL:    expr.m_Handler = selectBinary<TOKEN_BANG_EQUAL>(expr); break;
+        case TOKEN_PLUS:          expr.m_Handler = selectBinary<TOKEN_PLUS>(expr); break;
+        default:
+            // Leave it to Interpreter::visitBinaryExpr.
+            break;
+    }
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitThisExpr(This& expr) {
+    expr.m_Handler = thisExpr;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitSuperExpr(Super& expr) {
+    expr.m_Handler = superExpr;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitUnaryExpr(Unary& expr) {
+    compile(expr.m_Right.get());
+
+    if (expr.m_Operator.type == TOKEN_MINUS) {
+        expr.m_Handler = unary<TOKEN_MINUS>;
+    } else if (expr.m_Operator.type == TOKEN_BANG) {
+        expr.m_Handler = unary<TOKEN_BANG>;
+    }
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitVariableExpr(Variable& expr) {
+    if (expr.m_GlobalIndex != -1) {
+        expr.m_Handler = globalVariable;
+    } else if (expr.m_Slot != -1) {
+        expr.m_Handler = expr.m_InCell ? cellVariable : localVariable;
+    } else if (expr.m_Upvalue != -1) {
+        expr.m_Handler = upvalueVariable;
+    } else {
+        expr.m_Handler = lateBoundVariable;
+    }
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitTernaryExpr(Ternary& expr) {
+    compile(expr.m_Expr.get());
+    compile(expr.m_TrueExpr.get());
+    compile(expr.m_FalseExpr.get());
+    expr.m_Handler = ternary;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitSpawnExpr(Spawn& expr) {
+    compile(expr.m_Call->m_Callee.get());
+    for (const auto& argument : expr.m_Call->m_Arguments) {
+        compile(argument.get());
+    }
+    expr.m_Handler = spawn;
+    return Object::Null();
+}
+
+Object ClosureCompiler::visitAwaitExpr(Await& expr) {
+    compile(expr.m_Future.get());
+    expr.m_Handler = await;
+    return Object::Null();
+}
+
+// STATEMENTS
+
+void ClosureCompiler::visitExpressionStmt(Expression& stmt) {
+    compile(stmt.m_Expression.get());
+    stmt.m_Handler = expression;
+}
+
+void ClosureCompiler::visitReturnStmt(Return& stmt) {
+    if (stmt.m_Value.has_value()) {
+        compile(stmt.m_Value->get());
+    }
+    stmt.m_Handler = returnStmt;
+}
+
+void ClosureCompiler::visitBreakStmt(Break& stmt) {
+    stmt.m_Handler = breakStmt;
+}
+
+void ClosureCompiler::visitLetStmt(Let& stmt) {
+    if (stmt.m_Initializer.has_value()) {
+        compile(stmt.m_Initializer->get());
+    }
+    stmt.m_Handler = let;
+}
+
+void ClosureCompiler::visitWhileStmt(While& stmt) {
+    compile(stmt.m_Condition.get());
+    compile(stmt.m_Body.get());
+    stmt.m_Handler = whileStmt;
+}
+
+void ClosureCompiler::visitIfStmt(If& stmt) {
+    compile(stmt.m_Condition.get());
+    compile(stmt.m_ThenBranch.get());
+    if (stmt.m_ElseBranch.has_value()) {
+        compile(stmt.m_ElseBranch->get());
+    }
+    stmt.m_Handler = ifStmt;
+}
+
+void ClosureCompiler::visitBlockStmt(Block& stmt) {
+    compile(stmt.m_Statements);
+    stmt.m_Handler = block;
+}
+
+void ClosureCompiler::visitFunctionStmt(Function& stmt) {
+    compile(stmt.m_Body);
+    stmt.m_Handler = function;
+}
+
+void ClosureCompiler::visitPrintStmt(Print& stmt) {
+    if (stmt.m_Expression.has_value()) {
+        compile(stmt.m_Expression->get());
+    }
+    stmt.m_Handler = print;
+}
+
+void ClosureCompiler::visitClazzStmt(Class& stmt) {
+    if (stmt.m_Superclass.has_value()) {
+        compile(stmt.m_Superclass->get());
+    }
+    for (auto& method : stmt.m_Methods) {
+        compile(method.get());
+    }
+    for (auto& staticMethod : stmt.m_StaticMethods) {
+        compile(staticMethod.get());
+    }
+    stmt.m_Handler = clazz;
+}
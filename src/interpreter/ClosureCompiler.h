@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include "../parser/Expr.h"
+#include "../parser/Stmt.h"
+#include "../util/Object.h"
+#include "../util/common.h"
+
+class Interpreter;
+
+/* Last pass before the Interpreter runs. It walks the resolved (and folded) AST once and installs a handler on every
+ * node: a plain function that does what the node needs with everything that can be decided ahead of time already
+ * decided. A Binary node gets the instantiation of its operator (and a separate one when its right operand is a
+ * literal, which is then read straight out of the node instead of being evaluated, and ones for local variable
+ * operands, which are read in place from their slots), a variable reads its environment slot, cell, upvalue or
+ * GlobalTable entry directly, and every other node calls its visit method on the Interpreter directly.
+ *
+ * Interpreter::evaluate/execute call the handler when there is one, so running a compiled tree is a chain of direct
+ * calls with no accept() double dispatch and no switch on the operator. Nodes without a handler (e.g. ones created
+ * after this pass ran) still go through the visitor.
+ * */
+class ClosureCompiler : public StmtVisitor, public ExprVisitor<Object> {
+private:
+    Interpreter& m_Interpreter;
+public:
+    explicit ClosureCompiler(Interpreter& interpreter);
+
+    void compile(std::vector<UniqueStmtPtr>& statements);
+
+    Object visitSetExpr(Set& expr) override;
+    Object visitLogicalExpr(Logical& expr) override;
+    Object visitLiteralExpr(Literal& expr) override;
+    Object visitGroupingExpr(Grouping& expr) override;
+    Object visitCallExpr(Call& expr) override;
+    Object visitAnonFunctionExpr(AnonFunction& expr) override;
+    Object visitGetExpr(Get& expr) override;
+    Object visitAssignExpr(Assign& expr) override;
+    Object visitBinaryExpr(Binary& expr) override;
+    Object visitThisExpr(This& expr) override;
+    Object visitSuperExpr(Super& expr) override;
+    Object visitUnaryExpr(Unary& expr) override;
+    Object visitVariableExpr(Variable& expr) override;
+    Object visitTernaryExpr(Ternary& expr) override;
+    Object visitSpawnExpr(Spawn& expr) override;
+    Object visitAwaitExpr(Await& expr) override;
+
+    void visitExpressionStmt(Expression& stmt) override;
+    void visitReturnStmt(Return& stmt) override;
+    void visitBreakStmt(Break& stmt) override;
+    void visitLetStmt(Let& stmt) override;
+    void visitWhileStmt(While& stmt) override;
+    void visitIfStmt(If& stmt) override;
+    void visitBlockStmt(Block& stmt) override;
+    void visitFunctionStmt(Function& stmt) override;
+    void visitPrintStmt(Print& stmt) override;
+    void visitClazzStmt(Class& stmt) override;
+
+private:
+    void compile(Expr* expr);
+    void compile(Stmt* stmt);
+};
@@ -0,0 +1,321 @@
+#include "ConstantFolder.h"
+
+#include <memory>
+#include <utility>
+
+#include "Interpreter.h"
+#include "RuntimeError.h"
+
+ConstantFolder::ConstantFolder(Interpreter& interpreter) : m_Interpreter(interpreter) {}
+
+void ConstantFolder::fold(std::vector<UniqueStmtPtr>& statements) {
+    std::vector<UniqueStmtPtr> folded;
+    for (auto& statement : statements) {
+        if (statement == nullptr) {
+            continue;
+        }
+
+        fold(statement);
+        if (statement == nullptr) {
+            continue;
+        }
+
+        bool endsControlFlow = dynamic_cast<Return*>(statement.get()) != nullptr ||
+                               dynamic_cast<Break*>(statement.get()) != nullptr;
+        folded.push_back(std::move(statement));
+
+        // Nothing after a return or a break in the same list of statements can ever run.
+        if (endsControlFlow) {
+            break;
+        }
+    }
+    statements = std::move(folded);
+}
+
+void ConstantFolder::fold(UniqueExprPtr& expr) {
+    if (expr == nullptr) {
+        return;
+    }
+
+    expr->accept(*this);
+    if (m_ExprReplacement != nullptr) {
+        expr = std::move(m_ExprReplacement);
+        m_ExprReplacement = nullptr;
+    }
+}
+
+void ConstantFolder::fold(UniqueStmtPtr& stmt) {
+    if (stmt == nullptr) {
+        return;
+    }
+
+    stmt->accept(*this);
+    if (m_StmtReplacement.has_value()) {
+        stmt = std::move(m_StmtReplacement.value());
+        m_StmtReplacement = std::nullopt;
+    }
+}
+
+std::optional<Object> ConstantFolder::evaluateConstant(Expr& expr) {
+    try {
+        return m_Interpreter.evaluate(&expr);
+    } catch (RuntimeError&) {
+        return std::nullopt;
+    }
+}
+
+Literal* ConstantFolder::asLiteral(const UniqueExprPtr& expr) {
+    return dynamic_cast<Literal*>(expr.get());
+}
+
+bool ConstantFolder::containsBreak(Stmt* stmt) {
+    if (stmt == nullptr) {
+        return false;
+    }
+    if (dynamic_cast<Break*>(stmt) != nullptr) {
+        return true;
+    }
+    if (auto block = dynamic_cast<Block*>(stmt)) {
+        for (const auto& statement : block->m_Statements) {
+            if (containsBreak(statement.get())) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (auto ifStmt = dynamic_cast<If*>(stmt)) {
+        return containsBreak(ifStmt->m_ThenBranch.get()) ||
+               (ifStmt->m_ElseBranch.has_value() && containsBreak(ifStmt->m_ElseBranch->get()));
+    }
+    // A break inside a nested loop belongs to that loop.
+    return false;
+}
+
+// EXPRESSIONS
+
+Object ConstantFolder::visitSetExpr(Set& expr) {
+    fold(expr.m_Object);
+    fold(expr.m_Value);
+    return Object::Null();
+}
+
+Object ConstantFolder::visitLogicalExpr(Logical& expr) {
+    fold(expr.m_Left);
+    fold(expr.m_Right);
+
+    Literal* left = asLiteral(expr.m_Left);
+    if (left == nullptr) {
+        return Object::Null();
+    }
+
+    // Same short-circuit rules as Interpreter::visitLogicalExpr: the result is either the left operand itself or
+    // whatever the right operand evaluates to.
+    bool leftIsResult = expr.m_Operator.type == TokenType::TOKEN_OR ? m_Interpreter.isTruthy(left->m_Literal)
+                                                                     : !m_Interpreter.isTruthy(left->m_Literal);
+    m_ExprReplacement = leftIsResult ? expr.m_Left : expr.m_Right;
+    return Object::Null();
+}
+
+Object ConstantFolder::visitLiteralExpr(Literal&) {
+    return Object::Null();
+}
+
+Object ConstantFolder::visitGroupingExpr(Grouping& expr) {
+    fold(expr.m_Expression);
+
+    if (asLiteral(expr.m_Expression) != nullptr) {
+        m_ExprReplacement = expr.m_Expression;
+    }
+    return Object::Null();
+}
+
+Object ConstantFolder::visitCallExpr(Call& expr) {
+    fold(expr.m_Callee);
+    for (auto& argument : expr.m_Arguments) {
+        fold(argument);
+    }
+    return Object::Null();
+}
+
+Object ConstantFolder::visitAnonFunctionExpr(AnonFunction& expr) {
+    fold(expr.m_Body);
+    return Object::Null();
+}
+
+Object ConstantFolder::visitGetExpr(Get& expr) {
+    fold(expr.m_Object);
+    return Object::Null();
+}
+
+Object ConstantFolder::visitAssignExpr(Assign& expr) {
+    fold(expr.m_Value);
+    return Object::Null();
+}
+
+Object ConstantFolder::visitBinaryExpr(Binary& expr) {
+    fold(expr.m_Left);
+    fold(expr.m_Right);
+
+    if (asLiteral(expr.m_Left) == nullptr || asLiteral(expr.m_Right) == nullptr) {
+        return Object::Null();
+    }
+
+    std::optional<Object> value = evaluateConstant(expr);
+    if (value.has_value()) {
+        m_ExprReplacement = std::make_unique<Literal>(value.value());
+    }
+    return Object::Null();
+}
+
+Object ConstantFolder::visitThisExpr(This&) {
+    return Object::Null();
+}
+
+Object ConstantFolder::visitSuperExpr(Super&) {
+    return Object::Null();
+}
+
+Object ConstantFolder::visitUnaryExpr(Unary& expr) {
+    fold(expr.m_Right);
+
+    if (asLiteral(expr.m_Right) == nullptr) {
+        return Object::Null();
+    }
+
+    std::optional<Object> value = evaluateConstant(expr);
+    if (value.has_value()) {
+        m_ExprReplacement = std::make_unique<Literal>(value.value());
+    }
+    return Object::Null();
+}
+
+Object ConstantFolder::visitVariableExpr(Variable&) {
+    return Object::Null();
+}
+
+Object ConstantFolder::visitTernaryExpr(Ternary& expr) {
+    fold(expr.m_Expr);
+    fold(expr.m_TrueExpr);
+    fold(expr.m_FalseExpr);
+
+    Literal* condition = asLiteral(expr.m_Expr);
+    if (condition == nullptr) {
+        return Object::Null();
+    }
+
+    // The interpreter evaluates both branches, so the branch that isn't picked can only be dropped when evaluating it
+    // has no effect, which is only known for literals.
+    bool truthy = m_Interpreter.isTruthy(condition->m_Literal);
+    UniqueExprPtr& taken = truthy ? expr.m_TrueExpr : expr.m_FalseExpr;
+    UniqueExprPtr& dropped = truthy ? expr.m_FalseExpr : expr.m_TrueExpr;
+    if (asLiteral(dropped) != nullptr) {
+        m_ExprReplacement = taken;
+    }
+    return Object::Null();
+}
+
+Object ConstantFolder::visitSpawnExpr(Spawn& expr) {
+    visitCallExpr(*expr.m_Call);
+    return Object::Null();
+}
+
+Object ConstantFolder::visitAwaitExpr(Await& expr) {
+    fold(expr.m_Future);
+    return Object::Null();
+}
+
+// STATEMENTS
+
+void ConstantFolder::visitExpressionStmt(Expression& stmt) {
+    fold(stmt.m_Expression);
+
+    // A literal on its own has no effect.
+    if (asLiteral(stmt.m_Expression) != nullptr) {
+        m_StmtReplacement = nullptr;
+    }
+}
+
+void ConstantFolder::visitReturnStmt(Return& stmt) {
+    if (stmt.m_Value.has_value()) {
+        fold(stmt.m_Value.value());
+    }
+}
+
+void ConstantFolder::visitBreakStmt(Break&) {
+}
+
+void ConstantFolder::visitLetStmt(Let& stmt) {
+    if (stmt.m_Initializer.has_value()) {
+        fold(stmt.m_Initializer.value());
+    }
+}
+
+void ConstantFolder::visitWhileStmt(While& stmt) {
+    fold(stmt.m_Condition);
+    fold(stmt.m_Body);
+
+    Literal* condition = asLiteral(stmt.m_Condition);
+    if (condition != nullptr && !m_Interpreter.isTruthy(condition->m_Literal)) {
+        m_StmtReplacement = nullptr;
+        return;
+    }
+
+    // The body may have been folded away entirely, e.g. `while (x) if (false) ...;`.
+    if (stmt.m_Body == nullptr) {
+        stmt.m_Body = std::make_unique<Block>(std::vector<UniqueStmtPtr>());
+    }
+}
+
+void ConstantFolder::visitIfStmt(If& stmt) {
+    fold(stmt.m_Condition);
+    fold(stmt.m_ThenBranch);
+    if (stmt.m_ElseBranch.has_value()) {
+        fold(stmt.m_ElseBranch.value());
+    }
+
+    Literal* condition = asLiteral(stmt.m_Condition);
+    if (condition == nullptr) {
+        if (stmt.m_ThenBranch == nullptr) {
+            stmt.m_ThenBranch = std::make_unique<Block>(std::vector<UniqueStmtPtr>());
+        }
+        return;
+    }
+
+    UniqueStmtPtr taken = nullptr;
+    if (m_Interpreter.isTruthy(condition->m_Literal)) {
+        taken = stmt.m_ThenBranch;
+    } else if (stmt.m_ElseBranch.has_value()) {
+        taken = stmt.m_ElseBranch.value();
+    }
+
+    if (containsBreak(taken.get())) {
+        if (stmt.m_ThenBranch == nullptr) {
+            stmt.m_ThenBranch = std::make_unique<Block>(std::vector<UniqueStmtPtr>());
+        }
+        return;
+    }
+    m_StmtReplacement = std::move(taken);
+}
+
+void ConstantFolder::visitBlockStmt(Block& stmt) {
+    fold(stmt.m_Statements);
+}
+
+void ConstantFolder::visitFunctionStmt(Function& stmt) {
+    fold(stmt.m_Body);
+}
+
+void ConstantFolder::visitPrintStmt(Print& stmt) {
+    if (stmt.m_Expression.has_value()) {
+        fold(stmt.m_Expression.value());
+    }
+}
+
+void ConstantFolder::visitClazzStmt(Class& stmt) {
+    for (auto& method : stmt.m_Methods) {
+        fold(method->m_Body);
+    }
+    for (auto& staticMethod : stmt.m_StaticMethods) {
+        fold(staticMethod->m_Body);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "../parser/Expr.h"
+#include "../parser/Stmt.h"
+#include "../util/Object.h"
+#include "../util/common.h"
+
+class Interpreter;
+
+/* Optimization pass that runs on the resolved AST, between the Resolver and the Interpreter.
+ *
+ * It folds Binary/Unary/Logical/Ternary/Grouping nodes whose operands are literals into a single Literal, prunes If
+ * and While statements whose condition is a literal and drops statements that can never run because they follow a
+ * return or a break. Constant expressions are evaluated by the Interpreter itself, so the folded value is exactly what
+ * the expression would have produced at runtime. Expressions that would raise a runtime error (e.g. `1 / 0`) are
+ * left alone so the error still happens when (and if) the code runs.
+ * */
+class ConstantFolder : public StmtVisitor, public ExprVisitor<Object> {
+private:
+    Interpreter& m_Interpreter;
+
+    // Set by an expression visit when the visited node should be replaced in its parent.
+    UniqueExprPtr m_ExprReplacement;
+
+    // Set by a statement visit when the visited node should be replaced in its parent. A nullptr replacement means
+    // that the statement is removed.
+    std::optional<UniqueStmtPtr> m_StmtReplacement;
+public:
+    explicit ConstantFolder(Interpreter& interpreter);
+
+    void fold(std::vector<UniqueStmtPtr>& statements);
+
+    Object visitSetExpr(Set& expr) override;
+    Object visitLogicalExpr(Logical& expr) override;
+    Object visitLiteralExpr(Literal& expr) override;
+    Object visitGroupingExpr(Grouping& expr) override;
+    Object visitCallExpr(Call& expr) override;
+    Object visitAnonFunctionExpr(AnonFunction& expr) override;
+    Object visitGetExpr(Get& expr) override;
+    Object visitAssignExpr(Assign& expr) override;
+    Object visitBinaryExpr(Binary& expr) override;
+    Object visitThisExpr(This& expr) override;
+    Object visitSuperExpr(Super& expr) override;
+    Object visitUnaryExpr(Unary& expr) override;
+    Object visitVariableExpr(Variable& expr) override;
+    Object visitTernaryExpr(Ternary& expr) override;
+    Object visitSpawnExpr(Spawn& expr) override;
+    Object visitAwaitExpr(Await& expr) override;
+
+    void visitExpressionStmt(Expression& stmt) override;
+    void visitReturnStmt(Return& stmt) override;
+    void visitBreakStmt(Break& stmt) override;
+    void visitLetStmt(Let& stmt) override;
+    void visitWhileStmt(While& stmt) override;
+    void visitIfStmt(If& stmt) override;
+    void visitBlockStmt(Block& stmt) override;
+    void visitFunctionStmt(Function& stmt) override;
+    void visitPrintStmt(Print& stmt) override;
+    void visitClazzStmt(Class& stmt) override;
+
+private:
+    void fold(UniqueExprPtr& expr);
+    void fold(UniqueStmtPtr& stmt);
+
+    // Evaluates an expression whose operands are all literals. Returns nothing if evaluating it raises a runtime error.
+    std::optional<Object> evaluateConstant(Expr& expr);
+
+    static Literal* asLiteral(const UniqueExprPtr& expr);
+
+    // `break` inside an `if` only leaves the `if` (see Interpreter::visitIfStmt), so a branch containing one can't be
+    // hoisted out of its `if` without changing what the break does.
+    static bool containsBreak(Stmt* stmt);
+};
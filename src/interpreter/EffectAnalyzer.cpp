@@ -0,0 +1,451 @@
+#include "EffectAnalyzer.h"
+
+#include <algorithm>
+
+#include "Interpreter.h"
+#include "KarolaScriptClass.h"
+#include "../util/ErrorReporter.h"
+
+EffectAnalyzer::EffectAnalyzer(Interpreter& interpreter) : m_Interpreter(interpreter) {}
+
+void EffectAnalyzer::analyze(std::vector<UniqueStmtPtr>& statements) {
+    m_Functions.clear();
+    m_FunctionIndices.clear();
+    m_Declarations.clear();
+    m_Assigned.clear();
+    m_Constants.clear();
+    m_MethodsByName.clear();
+    m_SetProperties.clear();
+
+    m_Collecting = true;
+    for (const auto& statement : statements) {
+        recordTopLevelDeclaration(statement.get());
+        visit(statement.get());
+    }
+    m_Collecting = false;
+
+    for (const auto& statement : statements) {
+        const Stmt* declaration = statement.get();
+        int globalIndex = -1;
+        if (auto function = dynamic_cast<const Function*>(declaration)) {
+            globalIndex = function->m_GlobalIndex;
+        } else if (auto klass = dynamic_cast<const Class*>(declaration)) {
+            globalIndex = klass->m_GlobalIndex;
+        }
+        if (globalIndex != -1 && m_Declarations[globalIndex] == 1 && m_Assigned.count(globalIndex) == 0) {
+            m_Constants[globalIndex] = declaration;
+        }
+    }
+
+    visit(statements);
+    propagate();
+    warnAboutMemoizedFunctions();
+}
+
+void EffectAnalyzer::visit(const std::vector<UniqueStmtPtr>& statements) {
+    for (const auto& statement : statements) {
+        visit(statement.get());
+    }
+}
+
+void EffectAnalyzer::visit(Expr* expr) {
+    if (expr != nullptr) {
+        expr->accept(*this);
+    }
+}
+
+void EffectAnalyzer::visit(Stmt* stmt) {
+    if (stmt != nullptr) {
+        stmt->accept(*this);
+    }
+}
+
+void EffectAnalyzer::recordTopLevelDeclaration(const Stmt* stmt) {
+    if (auto function = dynamic_cast<const Function*>(stmt)) {
+        m_Declarations[function->m_GlobalIndex]++;
+    } else if (auto let = dynamic_cast<const Let*>(stmt)) {
+        m_Declarations[let->m_GlobalIndex]++;
+    } else if (auto klass = dynamic_cast<const Class*>(stmt)) {
+        m_Declarations[klass->m_GlobalIndex]++;
+    }
+}
+
+void EffectAnalyzer::visitFunctionBody(const std::vector<UniqueStmtPtr>& body, Effect* effect, std::string* sharedWrite,
+                                       const Function* declaration, bool isInitializer) {
+    int enclosing = m_Current;
+    bool enclosingInInitializer = m_InInitializer;
+    if (!m_Collecting) {
+        m_Current = static_cast<int>(m_Functions.size());
+        m_Functions.push_back(FunctionInfo{effect, sharedWrite, declaration});
+        if (declaration != nullptr) {
+            m_FunctionIndices[declaration] = m_Current;
+        }
+    }
+    m_InInitializer = isInitializer;
+
+    visit(body);
+
+    m_Current = enclosing;
+    m_InInitializer = enclosingInInitializer;
+}
+
+void EffectAnalyzer::effect(Effect effect, const std::string& reason) {
+    if (m_Current == -1) {
+        return;
+    }
+    FunctionInfo& function = m_Functions[m_Current];
+    if (effect > function.ownEffect) {
+        function.ownEffect = effect;
+        function.reason = reason;
+    }
+}
+
+void EffectAnalyzer::sharedWrite(const std::string& reason) {
+    if (m_Current != -1 && m_Functions[m_Current].ownSharedWrite.empty()) {
+        m_Functions[m_Current].ownSharedWrite = reason;
+    }
+}
+
+const Object* EffectAnalyzer::predefinedGlobal(int globalIndex) const {
+    if (globalIndex == -1 || m_Declarations.count(globalIndex) != 0 || m_Assigned.count(globalIndex) != 0) {
+        return nullptr;
+    }
+    const Object* value = m_Interpreter.getGlobals().find(globalIndex);
+    if (value == nullptr || !value->isCallable() || value->getCallable()->m_Type == KarolaScriptCallable::FUNCTION) {
+        return nullptr;
+    }
+    return value;
+}
+
+bool EffectAnalyzer::recordCall(const Expr* callee) {
+    if (auto variable = dynamic_cast<const Variable*>(callee)) {
+        auto constant = m_Constants.find(variable->m_GlobalIndex);
+        if (constant != m_Constants.end()) {
+            if (auto function = dynamic_cast<const Function*>(constant->second)) {
+                m_Functions[m_Current].callees.push_back(function);
+                return true;
+            }
+            return recordConstruction(static_cast<const Class&>(*constant->second));
+        }
+
+        const Object* native = predefinedGlobal(variable->m_GlobalIndex);
+        if (native != nullptr && native->isCallable() && native->getCallable()->m_Type == KarolaScriptCallable::NATIVE) {
+            recordNativeCall(*native);
+            return true;
+        }
+        return false;
+    }
+
+    if (auto super = dynamic_cast<const Super*>(callee)) {
+        // `super.init(...)` from an initializer sets up the instance being constructed, like the initializer itself.
+        const std::string& name = super->m_Method.lexeme;
+        return (name != "init" || m_InInitializer) && recordMethodCall(name);
+    }
+
+    auto get = dynamic_cast<const Get*>(callee);
+    if (get == nullptr) {
+        return false;
+    }
+
+    // A static method of a known class, e.g. `Math.sqrr00t(x)`.
+    auto object = dynamic_cast<const Variable*>(get->m_Object.get());
+    if (object != nullptr) {
+        auto constant = m_Constants.find(object->m_GlobalIndex);
+        if (constant != m_Constants.end()) {
+            auto klass = dynamic_cast<const Class*>(constant->second);
+            if (klass == nullptr) {
+                return false;
+            }
+            for (const auto& staticMethod : klass->m_StaticMethods) {
+                if (staticMethod->m_Name.lexeme == get->m_Name.lexeme) {
+                    m_Functions[m_Current].callees.push_back(staticMethod.get());
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        if (const Object* predefined = predefinedGlobal(object->m_GlobalIndex)) {
+            if (predefined->getCallable()->m_Type != KarolaScriptCallable::CLASS) {
+                return false;
+            }
+            auto klass = static_cast<KarolaScriptClass*>(predefined->getCallable().get());
+            Object staticMethod = klass->findStaticMethod(get->m_Name.lexeme).value();
+            if (!staticMethod.isCallable() || staticMethod.getCallable()->m_Type != KarolaScriptCallable::NATIVE) {
+                return false;
+            }
+            recordNativeCall(staticMethod);
+            return true;
+        }
+    }
+
+    // Calling `init` again re-initializes an instance that already exists.
+    const std::string& name = get->m_Name.lexeme;
+    if (name == "init" || m_SetProperties.count(name) != 0 || !recordMethodCall(name)) {
+        return false;
+    }
+    visit(get->m_Object.get());
+    return true;
+}
+
+bool EffectAnalyzer::recordConstruction(const Class& klass) {
+    for (const auto& method : klass.m_Methods) {
+        if (method->m_Name.lexeme == "init") {
+            m_Functions[m_Current].callees.push_back(method.get());
+            return true;
+        }
+    }
+    if (!klass.m_Superclass.has_value()) {
+        return true;
+    }
+
+    // The initializer is inherited.
+    auto superclass = m_Constants.find(klass.m_Superclass.value()->m_GlobalIndex);
+    if (superclass == m_Constants.end() || dynamic_cast<const Class*>(superclass->second) == nullptr) {
+        return false;
+    }
+    return recordConstruction(static_cast<const Class&>(*superclass->second));
+}
+
+bool EffectAnalyzer::recordMethodCall(const std::string& name) {
+    auto methods = m_MethodsByName.find(name);
+    if (methods == m_MethodsByName.end()) {
+        return false;
+    }
+    for (const Function* method : methods->second) {
+        m_Functions[m_Current].callees.push_back(method);
+    }
+    return true;
+}
+
+void EffectAnalyzer::recordNativeCall(const Object& callable) {
+    const SharedCallablePtr& native = callable.getCallable();
+    effect(native->effect(), "it calls " + native->name());
+}
+
+void EffectAnalyzer::propagate() {
+    for (FunctionInfo& function : m_Functions) {
+        *function.effect = function.ownEffect;
+        *function.sharedWrite = function.ownSharedWrite;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (FunctionInfo& function : m_Functions) {
+            for (const Function* callee : function.callees) {
+                Effect calleeEffect = callee->m_Effect;
+                if (calleeEffect > *function.effect) {
+                    *function.effect = calleeEffect;
+                    function.reason = "it calls " + callee->m_Name.lexeme;
+                    changed = true;
+                }
+                if (function.sharedWrite->empty() && !callee->m_SharedWrite.empty()) {
+                    *function.sharedWrite = "it calls " + callee->m_Name.lexeme;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+void EffectAnalyzer::warnAboutMemoizedFunctions() const {
+    for (const FunctionInfo& function : m_Functions) {
+        if (function.declaration == nullptr || function.declaration->m_MemoCapacity == 0) {
+            continue;
+        }
+
+        std::string warningMessage = "Function " + function.declaration->m_Name.lexeme + " is marked @memo but ";
+        if (*function.effect == EFFECT_EFFECTFUL) {
+            warningMessage += "has side effects (" + function.reason + "), which calls answered from its cache skip.";
+        } else if (*function.effect == EFFECT_READ_ONLY) {
+            warningMessage += "its result can depend on more than its arguments (" + function.reason + ").";
+        } else {
+            continue;
+        }
+        ErrorReporter::warning(warningMessage.c_str());
+    }
+}
+
+// EXPRESSIONS
+
+Object EffectAnalyzer::visitSetExpr(Set& expr) {
+    if (m_Collecting) {
+        m_SetProperties.insert(expr.m_Name.lexeme);
+    }
+    if (!m_InInitializer || dynamic_cast<This*>(expr.m_Object.get()) == nullptr) {
+        effect(EFFECT_EFFECTFUL, "it sets property " + expr.m_Name.lexeme);
+        sharedWrite("it sets property " + expr.m_Name.lexeme);
+    }
+    visit(expr.m_Object.get());
+    visit(expr.m_Value.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitLogicalExpr(Logical& expr) {
+    visit(expr.m_Left.get());
+    visit(expr.m_Right.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitLiteralExpr(Literal&) {
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitGroupingExpr(Grouping& expr) {
+    visit(expr.m_Expression.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitCallExpr(Call& expr) {
+    if (m_Collecting || m_Current == -1) {
+        visit(expr.m_Callee.get());
+    } else if (!recordCall(expr.m_Callee.get())) {
+        effect(EFFECT_EFFECTFUL, "it makes a call the analysis can't follow");
+        sharedWrite("it makes a call the analysis can't follow");
+        visit(expr.m_Callee.get());
+    }
+    for (const auto& argument : expr.m_Arguments) {
+        visit(argument.get());
+    }
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitAnonFunctionExpr(AnonFunction& expr) {
+    visitFunctionBody(expr.m_Body, &expr.m_Effect, &expr.m_SharedWrite, nullptr, false);
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitGetExpr(Get& expr) {
+    effect(EFFECT_READ_ONLY, "it reads property " + expr.m_Name.lexeme);
+    visit(expr.m_Object.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitAssignExpr(Assign& expr) {
+    if (m_Collecting && expr.m_GlobalIndex != -1) {
+        m_Assigned.insert(expr.m_GlobalIndex);
+    }
+    if (expr.m_Slot == -1) {
+        effect(EFFECT_EFFECTFUL, "it assigns " + expr.m_Name.lexeme);
+        sharedWrite("it assigns " + expr.m_Name.lexeme);
+    }
+    visit(expr.m_Value.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitBinaryExpr(Binary& expr) {
+    visit(expr.m_Left.get());
+    visit(expr.m_Right.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitThisExpr(This&) {
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitSuperExpr(Super&) {
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitUnaryExpr(Unary& expr) {
+    visit(expr.m_Right.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitVariableExpr(Variable& expr) {
+    if (expr.m_Upvalue != -1) {
+        effect(EFFECT_READ_ONLY, "it reads captured variable " + expr.m_VariableName.lexeme);
+    } else if (expr.m_Slot == -1 && m_Constants.count(expr.m_GlobalIndex) == 0 &&
+               predefinedGlobal(expr.m_GlobalIndex) == nullptr) {
+        effect(EFFECT_READ_ONLY, "it reads global " + expr.m_VariableName.lexeme);
+    }
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitTernaryExpr(Ternary& expr) {
+    visit(expr.m_Expr.get());
+    visit(expr.m_TrueExpr.get());
+    visit(expr.m_FalseExpr.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitSpawnExpr(Spawn& expr) {
+    // The task does what the call does, only on another thread.
+    visit(expr.m_Call.get());
+    return Object::Null();
+}
+
+Object EffectAnalyzer::visitAwaitExpr(Await& expr) {
+    visit(expr.m_Future.get());
+    return Object::Null();
+}
+
+// STATEMENTS
+
+void EffectAnalyzer::visitExpressionStmt(Expression& stmt) {
+    visit(stmt.m_Expression.get());
+}
+
+void EffectAnalyzer::visitReturnStmt(Return& stmt) {
+    if (stmt.m_Value.has_value()) {
+        visit(stmt.m_Value->get());
+    }
+}
+
+void EffectAnalyzer::visitBreakStmt(Break&) {
+}
+
+void EffectAnalyzer::visitLetStmt(Let& stmt) {
+    if (stmt.m_Initializer.has_value()) {
+        visit(stmt.m_Initializer->get());
+    }
+}
+
+void EffectAnalyzer::visitWhileStmt(While& stmt) {
+    visit(stmt.m_Condition.get());
+    visit(stmt.m_Body.get());
+}
+
+void EffectAnalyzer::visitIfStmt(If& stmt) {
+    visit(stmt.m_Condition.get());
+    visit(stmt.m_ThenBranch.get());
+    if (stmt.m_ElseBranch.has_value()) {
+        visit(stmt.m_ElseBranch->get());
+    }
+}
+
+void EffectAnalyzer::visitBlockStmt(Block& stmt) {
+    visit(stmt.m_Statements);
+}
+
+void EffectAnalyzer::visitFunctionStmt(Function& stmt) {
+    visitFunctionBody(stmt.m_Body, &stmt.m_Effect, &stmt.m_SharedWrite, &stmt, false);
+}
+
+void EffectAnalyzer::visitPrintStmt(Print& stmt) {
+    effect(EFFECT_EFFECTFUL, "it prints");
+    if (stmt.m_Expression.has_value()) {
+        visit(stmt.m_Expression->get());
+    }
+}
+
+void EffectAnalyzer::visitClazzStmt(Class& stmt) {
+    if (m_Collecting) {
+        for (const auto& method : stmt.m_Methods) {
+            m_MethodsByName[method->m_Name.lexeme].push_back(method.get());
+        }
+        for (const auto& staticMethod : stmt.m_StaticMethods) {
+            m_MethodsByName[staticMethod->m_Name.lexeme].push_back(staticMethod.get());
+        }
+    }
+
+    for (const auto& method : stmt.m_Methods) {
+        visitFunctionBody(method->m_Body, &method->m_Effect, &method->m_SharedWrite, method.get(),
+                          method->m_Name.lexeme == "init");
+    }
+    for (const auto& staticMethod : stmt.m_StaticMethods) {
+        visitFunctionBody(staticMethod->m_Body, &staticMethod->m_Effect, &staticMethod->m_SharedWrite,
+                          staticMethod.get(), false);
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../parser/Expr.h"
+#include "../parser/Stmt.h"
+#include "../util/Object.h"
+#include "../util/common.h"
+
+class Interpreter;
+
+/* Whole-program side-effect analysis over the resolved AST. Tags every Function and AnonFunction with the Effect of
+ * calling it, for passes and runtime features that are only safe for code that doesn't change anything.
+ *
+ * A body's own effect comes from what it does directly: printing, assigning a variable it doesn't declare and setting
+ * a property are effectful; reading a global that can change, a captured variable or a property makes it read-only.
+ * Calls are followed when the callee is known ahead of time: a top-level function or class that is declared once and
+ * never assigned (its initializer, for a class), a native the program doesn't redefine (see
+ * KarolaScriptCallable::effect()), or a method. A method call can reach any method with that name, so it's followed to
+ * all of them, unless the program sets a property with that name somewhere (which would shadow the method with any
+ * value). Every other call (locals, call results) counts as effectful. The effect of a function is then the greatest
+ * of its own and those of the functions it calls, worked out to a fixpoint so recursion is handled.
+ *
+ * An initializer setting properties of `this` only sets up the instance being constructed, so that isn't an effect.
+ *
+ * Alongside the effect, the pass works out the same way whether calling a function can write state code elsewhere
+ * can see: a captured variable or a global, a property, or anything a call it can't follow might write. Printing
+ * doesn't count. parallelFor() only runs bodies that write no such state.
+ *
+ * The pass also warns about `@memo` functions that aren't pure.
+ * */
+class EffectAnalyzer : public StmtVisitor, public ExprVisitor<Object> {
+private:
+    Interpreter& m_Interpreter;
+
+    struct FunctionInfo {
+        // The m_Effect and m_SharedWrite of the node.
+        Effect* effect;
+        std::string* sharedWrite;
+        // Null for an anonymous function.
+        const Function* declaration;
+        // The effect of the body itself and the first thing in it that has that effect.
+        Effect ownEffect = EFFECT_PURE;
+        std::string reason = {};
+        // The first thing in the body itself that writes shared state.
+        std::string ownSharedWrite = {};
+        // Script functions it calls.
+        std::vector<const Function*> callees = {};
+    };
+    std::vector<FunctionInfo> m_Functions;
+    std::unordered_map<const Function*, size_t> m_FunctionIndices;
+
+    // The function whose body is being walked, -1 at the top level, and whether it's an initializer.
+    int m_Current = -1;
+    bool m_InInitializer = false;
+
+    // While collecting, the pass only records how every global is declared and assigned.
+    bool m_Collecting = false;
+    std::unordered_map<int, int> m_Declarations;
+    std::unordered_set<int> m_Assigned;
+    // Top-level functions and classes that are declared once and never assigned, by global index.
+    std::unordered_map<int, const Stmt*> m_Constants;
+    // Every method and static method of every class, by name, and the names of every property that is set.
+    std::unordered_map<std::string, std::vector<const Function*>> m_MethodsByName;
+    std::unordered_set<std::string> m_SetProperties;
+public:
+    explicit EffectAnalyzer(Interpreter& interpreter);
+
+    void analyze(std::vector<UniqueStmtPtr>& statements);
+
+    Object visitSetExpr(Set& expr) override;
+    Object visitLogicalExpr(Logical& expr) override;
+    Object visitLiteralExpr(Literal& expr) override;
+    Object visitGroupingExpr(Grouping& expr) override;
+    Object visitCallExpr(Call& expr) override;
+    Object visitAnonFunctionExpr(AnonFunction& expr) override;
+    Object visitGetExpr(Get& expr) override;
+    Object visitAssignExpr(Assign& expr) override;
+    Object visitBinaryExpr(Binary& expr) override;
+    Object visitThisExpr(This& expr) override;
+    Object visitSuperExpr(Super& expr) override;
+    Object visitUnaryExpr(Unary& expr) override;
+    Object visitVariableExpr(Variable& expr) override;
+    Object visitTernaryExpr(Ternary& expr) override;
+    Object visitSpawnExpr(Spawn& expr) override;
+    Object visitAwaitExpr(Await& expr) override;
+
+    void visitExpressionStmt(Expression& stmt) override;
+    void visitReturnStmt(Return& stmt) override;
+    void visitBreakStmt(Break& stmt) override;
+    void visitLetStmt(Let& stmt) override;
+    void visitWhileStmt(While& stmt) override;
+    void visitIfStmt(If& stmt) override;
+    void visitBlockStmt(Block& stmt) override;
+    void visitFunctionStmt(Function& stmt) override;
+    void visitPrintStmt(Print& stmt) override;
+    void visitClazzStmt(Class& stmt) override;
+
+private:
+    void visit(const std::vector<UniqueStmtPtr>& statements);
+    void visit(Expr* expr);
+    void visit(Stmt* stmt);
+
+    void recordTopLevelDeclaration(const Stmt* stmt);
+
+    // Walks the body of a function with an info of its own.
+    void visitFunctionBody(const std::vector<UniqueStmtPtr>& body, Effect* effect, std::string* sharedWrite,
+                           const Function* declaration, bool isInitializer);
+
+    // Records an effect of the body being walked.
+    void effect(Effect effect, const std::string& reason);
+    // Records a write of shared state by the body being walked.
+    void sharedWrite(const std::string& reason);
+
+    // The value of a global the program neither declares nor assigns when it's a native or a class (e.g. Math), or
+    // nullptr.
+    const Object* predefinedGlobal(int globalIndex) const;
+
+    // Records what calling `callee` does, returning false if the analysis can't tell.
+    bool recordCall(const Expr* callee);
+    bool recordConstruction(const Class& klass);
+    bool recordMethodCall(const std::string& name);
+    void recordNativeCall(const Object& callable);
+
+    // Propagates the effects of callees to their callers until nothing changes.
+    void propagate();
+    void warnAboutMemoizedFunctions() const;
+};
@@ -1,32 +1,89 @@
 #pragma once
 
 #include <memory>
-#include <string>
-#include <unordered_map>
+#include <stdexcept>
+#include <vector>
 
 #include "../util/Object.h"
 
+// A variable shared between the function declaring it and the closures capturing it.
+using SharedCellPtr = std::shared_ptr<Object>;
+
+/* The frame of one function call (or of top-level code): the local variables of the function and of every block in it.
+ * The Resolver gives each local a slot in its function's frame, stored on the AST nodes that use it, and a block's slots
+ * are reused once the block ends, so running a block doesn't need an environment of its own. Global variables live in
+ * the GlobalTable instead.
+ *
+ * Closures don't keep the frame they were created in alive. A variable that a nested function captures lives in a cell
+ * instead of its slot, and the closure copies the cells it needs when it's created. Inside the closure those are its
+ * upvalues.
+ * */
 class Environment {
 public:
-    std::shared_ptr<Environment> m_Enclosing;
-    std::unordered_map<std::string, Object> m_Values;
+    std::vector<Object> m_Slots;
+    std::vector<SharedCellPtr> m_Cells;
+    // Upvalues of the function this frame belongs to, owned by the function object being called.
+    const std::vector<SharedCellPtr>* m_Upvalues = nullptr;
 public:
     Environment() = default;
 
-    explicit Environment(std::shared_ptr<Environment> enclosing);
+    explicit Environment(size_t frameSize);
+
+    void define(int slot, const Object& value) {
+        size_t index = slotIndex(slot);
+        if (index >= m_Slots.size()) {
+            m_Slots.resize(index + 1);
+        }
+        m_Slots[index] = value;
+    }
+
+    // Drops the value in a slot. Top-level code has no frame size, so its frame may not have reached the slot yet.
+    void clear(int slot) {
+        size_t index = slotIndex(slot);
+        if (index < m_Slots.size()) {
+            m_Slots[index] = Object::Null();
+        }
+    }
+
+    // A slot whose declaration hasn't run (yet) reads as null.
+    const Object& get(int slot) const {
+        size_t index = slotIndex(slot);
+        return index < m_Slots.size() ? m_Slots[index] : nullObject();
+    }
+
+    // Declares a captured variable in a new cell, so every run of the declaration is captured separately.
+    void defineCell(int slot, const Object& value) {
+        size_t index = slotIndex(slot);
+        if (index >= m_Cells.size()) {
+            m_Cells.resize(index + 1);
+        }
+        m_Cells[index] = std::make_shared<Object>(value);
+    }
 
-    // Use the Token overload because it can then report errors using the token's line. Only use the string overload when there's no token.
-    void define(const Token& identifier, const Object& value);
-    void define(const std::string &key, const Object& value);
+    // A captured variable whose declaration hasn't run (yet) gets an empty cell, the same as get() reads null.
+    const SharedCellPtr& cell(int slot) {
+        size_t index = slotIndex(slot);
+        if (index >= m_Cells.size()) {
+            m_Cells.resize(index + 1);
+        }
+        if (m_Cells[index] == nullptr) {
+            m_Cells[index] = std::make_shared<Object>();
+        }
+        return m_Cells[index];
+    }
 
-    // `lookup()` can be renamed to `get()`
-    Object lookup(const Token& identifier);
-    Object lookup(const std::string& identifier);
-    Object getAt(int distance, const std::string& identifier);
+    Object& upvalue(int index) const {
+        return *(*m_Upvalues)[index];
+    }
 
-    void assign(const Token& identifier, const Object& value);
-    void assign(const std::string& identifier, const Object& value);
-    void assignAt(int distance, const Token& identifier, const Object& value);
+private:
+    static const Object& nullObject();
 
-    Environment* ancestor(int distance);
-};
\ No newline at end of file
+    // Slots come from the Resolver and are never negative, which is checked before they're compared with sizes.
+    static size_t slotIndex(int slot) {
+        if (slot < 0) {
+            throw std::out_of_range("Negative environment slot.");
+        }
+        return static_cast<size_t>(slot);
+    }
+};
@@ -0,0 +1,214 @@
+#include "EscapeAnalyzer.h"
+
+#include <utility>
+
+void EscapeAnalyzer::analyze(std::vector<UniqueStmtPtr>& statements) {
+    // Top-level code runs in a frame of its own too; its block locals have slots in it.
+    visitFunctionBody(statements);
+}
+
+void EscapeAnalyzer::visit(const std::vector<UniqueStmtPtr>& statements) {
+    for (const auto& statement : statements) {
+        visit(statement.get());
+    }
+}
+
+void EscapeAnalyzer::visit(Expr* expr) {
+    if (expr != nullptr) {
+        expr->accept(*this);
+    }
+}
+
+void EscapeAnalyzer::visit(Stmt* stmt) {
+    if (stmt != nullptr) {
+        stmt->accept(*this);
+    }
+}
+
+void EscapeAnalyzer::visitFunctionBody(const std::vector<UniqueStmtPtr>& body) {
+    std::unordered_map<int, Let*> enclosing = std::move(m_Candidates);
+    m_Candidates.clear();
+    visit(body);
+    m_Candidates = std::move(enclosing);
+}
+
+void EscapeAnalyzer::visitPropertyObject(Expr* object) {
+    auto variable = dynamic_cast<Variable*>(object);
+    if (variable != nullptr && m_Candidates.count(variable->m_Slot) != 0) {
+        return;
+    }
+    visit(object);
+}
+
+// EXPRESSIONS
+
+Object EscapeAnalyzer::visitSetExpr(Set& expr) {
+    visitPropertyObject(expr.m_Object.get());
+    visit(expr.m_Value.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitLogicalExpr(Logical& expr) {
+    visit(expr.m_Left.get());
+    visit(expr.m_Right.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitLiteralExpr(Literal&) {
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitGroupingExpr(Grouping& expr) {
+    visit(expr.m_Expression.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitCallExpr(Call& expr) {
+    visit(expr.m_Callee.get());
+    for (const auto& argument : expr.m_Arguments) {
+        visit(argument.get());
+    }
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitAnonFunctionExpr(AnonFunction& expr) {
+    visitFunctionBody(expr.m_Body);
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitGetExpr(Get& expr) {
+    visitPropertyObject(expr.m_Object.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitAssignExpr(Assign& expr) {
+    // Overwriting the variable doesn't let the instance it held escape.
+    visit(expr.m_Value.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitBinaryExpr(Binary& expr) {
+    visit(expr.m_Left.get());
+    visit(expr.m_Right.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitThisExpr(This&) {
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitSuperExpr(Super&) {
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitUnaryExpr(Unary& expr) {
+    visit(expr.m_Right.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitVariableExpr(Variable& expr) {
+    // A use other than a property access: the instance may escape.
+    auto candidate = m_Candidates.find(expr.m_Slot);
+    if (candidate != m_Candidates.end()) {
+        Let* let = candidate->second;
+        let->m_NonEscaping = false;
+        static_cast<Call*>(let->m_Initializer->get())->m_NonEscaping = false;
+        m_Candidates.erase(candidate);
+    }
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitTernaryExpr(Ternary& expr) {
+    visit(expr.m_Expr.get());
+    visit(expr.m_TrueExpr.get());
+    visit(expr.m_FalseExpr.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitSpawnExpr(Spawn& expr) {
+    visit(expr.m_Call.get());
+    return Object::Null();
+}
+
+Object EscapeAnalyzer::visitAwaitExpr(Await& expr) {
+    visit(expr.m_Future.get());
+    return Object::Null();
+}
+
+// STATEMENTS
+
+void EscapeAnalyzer::visitExpressionStmt(Expression& stmt) {
+    visit(stmt.m_Expression.get());
+}
+
+void EscapeAnalyzer::visitReturnStmt(Return& stmt) {
+    if (stmt.m_Value.has_value()) {
+        visit(stmt.m_Value->get());
+    }
+}
+
+void EscapeAnalyzer::visitBreakStmt(Break&) {
+}
+
+void EscapeAnalyzer::visitLetStmt(Let& stmt) {
+    if (stmt.m_Initializer.has_value()) {
+        visit(stmt.m_Initializer->get());
+    }
+    if (stmt.m_Slot == -1) {
+        return;
+    }
+
+    // The slot is reused for a new variable from here on.
+    m_Candidates.erase(stmt.m_Slot);
+    if (stmt.m_IsCaptured || !stmt.m_Initializer.has_value()) {
+        return;
+    }
+    auto call = dynamic_cast<Call*>(stmt.m_Initializer->get());
+    if (call != nullptr && dynamic_cast<Variable*>(call->m_Callee.get()) != nullptr) {
+        stmt.m_NonEscaping = true;
+        call->m_NonEscaping = true;
+        m_Candidates[stmt.m_Slot] = &stmt;
+    }
+}
+
+void EscapeAnalyzer::visitWhileStmt(While& stmt) {
+    visit(stmt.m_Condition.get());
+    visit(stmt.m_Body.get());
+}
+
+void EscapeAnalyzer::visitIfStmt(If& stmt) {
+    visit(stmt.m_Condition.get());
+    visit(stmt.m_ThenBranch.get());
+    if (stmt.m_ElseBranch.has_value()) {
+        visit(stmt.m_ElseBranch->get());
+    }
+}
+
+void EscapeAnalyzer::visitBlockStmt(Block& stmt) {
+    visit(stmt.m_Statements);
+}
+
+void EscapeAnalyzer::visitFunctionStmt(Function& stmt) {
+    m_Candidates.erase(stmt.m_Slot);
+    visitFunctionBody(stmt.m_Body);
+}
+
+void EscapeAnalyzer::visitPrintStmt(Print& stmt) {
+    if (stmt.m_Expression.has_value()) {
+        visit(stmt.m_Expression->get());
+    }
+}
+
+void EscapeAnalyzer::visitClazzStmt(Class& stmt) {
+    if (stmt.m_Superclass.has_value()) {
+        visit(stmt.m_Superclass->get());
+    }
+    m_Candidates.erase(stmt.m_Slot);
+    m_Candidates.erase(stmt.m_SuperSlot);
+    for (const auto& method : stmt.m_Methods) {
+        visitFunctionBody(method->m_Body);
+    }
+    for (const auto& staticMethod : stmt.m_StaticMethods) {
+        visitFunctionBody(staticMethod->m_Body);
+    }
+}
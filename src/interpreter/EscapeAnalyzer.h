@@ -0,0 +1,67 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "../parser/Expr.h"
+#include "../parser/Stmt.h"
+#include "../util/Object.h"
+#include "../util/common.h"
+
+/* Finds the instances that never leave the frame they're created in, so their call sites can recycle them.
+ *
+ * A candidate is a local `let p = Name(...);` that no nested function captures. It stays a candidate as long as every
+ * use of `p` is a property access on it (`p.x`, `p.x = ...`, `p.m(...)`); any other use (passing it to a function,
+ * returning it, storing it somewhere, printing it) means the instance may outlive the frame. Surviving candidates get
+ * Let::m_NonEscaping and Call::m_NonEscaping set, and the Interpreter then constructs the instance of such a call into
+ * the one it created there last time, once nothing references that one anymore (see KarolaScriptClass::newInstance).
+ *
+ * Methods, including `init`, see the instance as `this` and can still store it somewhere, which the pass can't know, so
+ * it only picks the call sites: an instance is never reused while anything else holds a reference to it.
+ * */
+class EscapeAnalyzer : public StmtVisitor, public ExprVisitor<Object> {
+private:
+    // The candidate each local slot of the frame being analyzed holds at this point of the walk.
+    std::unordered_map<int, Let*> m_Candidates;
+public:
+    void analyze(std::vector<UniqueStmtPtr>& statements);
+
+    Object visitSetExpr(Set& expr) override;
+    Object visitLogicalExpr(Logical& expr) override;
+    Object visitLiteralExpr(Literal& expr) override;
+    Object visitGroupingExpr(Grouping& expr) override;
+    Object visitCallExpr(Call& expr) override;
+    Object visitAnonFunctionExpr(AnonFunction& expr) override;
+    Object visitGetExpr(Get& expr) override;
+    Object visitAssignExpr(Assign& expr) override;
+    Object visitBinaryExpr(Binary& expr) override;
+    Object visitThisExpr(This& expr) override;
+    Object visitSuperExpr(Super& expr) override;
+    Object visitUnaryExpr(Unary& expr) override;
+    Object visitVariableExpr(Variable& expr) override;
+    Object visitTernaryExpr(Ternary& expr) override;
+    Object visitSpawnExpr(Spawn& expr) override;
+    Object visitAwaitExpr(Await& expr) override;
+
+    void visitExpressionStmt(Expression& stmt) override;
+    void visitReturnStmt(Return& stmt) override;
+    void visitBreakStmt(Break& stmt) override;
+    void visitLetStmt(Let& stmt) override;
+    void visitWhileStmt(While& stmt) override;
+    void visitIfStmt(If& stmt) override;
+    void visitBlockStmt(Block& stmt) override;
+    void visitFunctionStmt(Function& stmt) override;
+    void visitPrintStmt(Print& stmt) override;
+    void visitClazzStmt(Class& stmt) override;
+
+private:
+    void visit(const std::vector<UniqueStmtPtr>& statements);
+    void visit(Expr* expr);
+    void visit(Stmt* stmt);
+
+    // Analyzes a function body as a frame of its own.
+    void visitFunctionBody(const std::vector<UniqueStmtPtr>& body);
+
+    // Visits the object of a property access: the object itself being a candidate is fine.
+    void visitPropertyObject(Expr* object);
+};
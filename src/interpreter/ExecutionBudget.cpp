@@ -0,0 +1,73 @@
+#include "ExecutionBudget.h"
+
+#include <algorithm>
+#include <string>
+
+#include "RuntimeError.h"
+
+ExecutionBudget::~ExecutionBudget() {
+    if (m_Countdown <= m_SliceSize) {
+        m_Usage->stepsTaken.fetch_add(m_SliceSize - m_Countdown, std::memory_order_relaxed);
+    }
+}
+
+void ExecutionBudget::configure(const ExecutionLimits& limits) {
+    m_Limits = limits;
+    start();
+}
+
+void ExecutionBudget::share(const ExecutionBudget& parent) {
+    m_Limits = parent.m_Limits;
+    m_Usage = parent.m_Usage;
+    m_MemoryCap = m_Limits.maxMemoryBytes != 0 ? m_Limits.maxMemoryBytes : std::numeric_limits<size_t>::max();
+    m_Deadline = parent.m_Deadline;
+    nextSlice();
+}
+
+void ExecutionBudget::start() {
+    m_Usage->stepsTaken = 0;
+    m_Usage->allocated = 0;
+    m_MemoryCap = m_Limits.maxMemoryBytes != 0 ? m_Limits.maxMemoryBytes : std::numeric_limits<size_t>::max();
+    m_Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_Limits.timeoutMs);
+    nextSlice();
+}
+
+bool ExecutionBudget::isLimited() const {
+    return m_Limits.maxSteps != 0 || m_Limits.timeoutMs != 0 || m_Limits.maxMemoryBytes != 0;
+}
+
+void ExecutionBudget::nextSlice() {
+    if (m_Limits.maxSteps == 0 && m_Limits.timeoutMs == 0) {
+        m_SliceSize = UNLIMITED;
+    } else if (m_Limits.maxSteps != 0) {
+        // Never hand out more steps than are left, so the step limit is hit exactly. Another thread may have gone past
+        // it already, then the next step fails.
+        uint64_t taken = m_Usage->stepsTaken.load(std::memory_order_relaxed);
+        m_SliceSize = taken <= m_Limits.maxSteps ? std::min(CHECK_INTERVAL, m_Limits.maxSteps - taken + 1) : 1;
+    } else {
+        m_SliceSize = CHECK_INTERVAL;
+    }
+    m_Countdown = m_SliceSize;
+}
+
+void ExecutionBudget::checkpoint() {
+    uint64_t taken = m_Usage->stepsTaken.fetch_add(m_SliceSize, std::memory_order_relaxed) + m_SliceSize;
+
+    if (m_Limits.maxSteps != 0 && taken > m_Limits.maxSteps) {
+        // Let the error handler (and anything it evaluates) run without tripping the limit again.
+        m_Countdown = UNLIMITED;
+        throw BudgetExceededError("Execution budget exceeded: more than " + std::to_string(m_Limits.maxSteps) + " steps.");
+    }
+
+    if (m_Limits.timeoutMs != 0 && std::chrono::steady_clock::now() >= m_Deadline) {
+        m_Countdown = UNLIMITED;
+        throw BudgetExceededError("Execution budget exceeded: ran longer than " + std::to_string(m_Limits.timeoutMs) + " ms.");
+    }
+
+    nextSlice();
+}
+
+void ExecutionBudget::memoryExceeded() {
+    m_MemoryCap = std::numeric_limits<size_t>::max();
+    throw BudgetExceededError("Execution budget exceeded: allocated more than " + std::to_string(m_Limits.maxMemoryBytes) + " bytes.");
+}
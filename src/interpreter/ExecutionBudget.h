@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// Limits applied to a single Interpreter (isolate). A value of 0 means "unlimited".
+struct ExecutionLimits {
+    uint64_t maxSteps = 0;              // max number of evaluated expressions + executed statements
+    uint64_t timeoutMs = 0;             // wall-clock budget, measured from the start of Interpreter::interpret()
+    size_t maxMemoryBytes = 0;          // cap on bytes allocated for objects, environments and instances
+};
+
+/* ExecutionBudget is checked from the hottest paths of the interpreter (every evaluate/execute), so the common
+ * case has to stay a single decrement and compare. Steps are counted down in slices of CHECK_INTERVAL and the
+ * expensive checks (step limit, clock) only happen when a slice runs out. With no limits configured the countdown
+ * starts at UINT64_MAX and never reaches the slow path.
+ *
+ * Tasks running script code on other threads (see TaskPool) get budgets of their own, made with share(), that draw on
+ * the steps and memory of the budget they were started from. Each thread counts its slice down on its own and only
+ * adds it to the shared total when it runs out, so with tasks running the step limit can be overshot by up to a slice
+ * per thread.
+ * */
+class ExecutionBudget {
+private:
+    static constexpr uint64_t CHECK_INTERVAL = 1024;
+    static constexpr uint64_t UNLIMITED = std::numeric_limits<uint64_t>::max();
+
+    // Used up by a budget and all the budgets shared from it.
+    struct Usage {
+        std::atomic<uint64_t> stepsTaken{0};
+        std::atomic<size_t> allocated{0};
+    };
+
+    ExecutionLimits m_Limits;
+
+    uint64_t m_Countdown = UNLIMITED;
+    uint64_t m_SliceSize = UNLIMITED;
+
+    std::shared_ptr<Usage> m_Usage = std::make_shared<Usage>();
+    size_t m_MemoryCap = std::numeric_limits<size_t>::max();
+
+    std::chrono::steady_clock::time_point m_Deadline;
+public:
+    ExecutionBudget() = default;
+    // Adds the steps of the unfinished slice to the total, for a task's budget that goes away when the task is done.
+    ~ExecutionBudget();
+
+    ExecutionBudget(const ExecutionBudget&) = delete;
+    ExecutionBudget& operator=(const ExecutionBudget&) = delete;
+
+    void configure(const ExecutionLimits& limits);
+
+    // Makes this the budget of a task started by code running on `parent`: the same limits and deadline, drawing on the
+    // same steps and memory.
+    void share(const ExecutionBudget& parent);
+
+    // Resets the counters and starts the clock. Called at the start of every top-level run.
+    void start();
+
+    bool isLimited() const;
+
+    void tick() {
+        if (--m_Countdown == 0) {
+            checkpoint();
+        }
+    }
+
+    void charge(size_t bytes) {
+        if (m_MemoryCap != std::numeric_limits<size_t>::max() &&
+            m_Usage->allocated.fetch_add(bytes, std::memory_order_relaxed) + bytes > m_MemoryCap) {
+            memoryExceeded();
+        }
+    }
+
+private:
+    void nextSlice();
+    void checkpoint();
+    [[noreturn]] void memoryExceeded();
+};
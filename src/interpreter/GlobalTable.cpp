@@ -0,0 +1,48 @@
+#include "GlobalTable.h"
+
+#include "RuntimeError.h"
+
+int GlobalTable::indexOf(const std::string& name) {
+    auto found = m_Indices.find(name);
+    if (found != m_Indices.end()) {
+        return found->second;
+    }
+
+    int index = static_cast<int>(m_Values.size());
+    m_Indices.emplace(name, index);
+    m_Names.push_back(name);
+    m_Values.emplace_back();
+    m_Defined.push_back(false);
+    m_Versions.push_back(0);
+    return index;
+}
+
+void GlobalTable::define(int index, const Object& value) {
+    if (m_Defined[index]) {
+        throw RuntimeError("Cannot redefine a variable. Variable '" + m_Names[index] + "' has already been defined");
+    }
+
+    m_Values[index] = value;
+    m_Defined[index] = true;
+    m_Versions[index]++;
+}
+
+const Object& GlobalTable::lookup(const Token& identifier) const {
+    auto found = m_Indices.find(identifier.lexeme);
+    if (found == m_Indices.end()) {
+        undefined(identifier);
+    }
+    return get(found->second, identifier);
+}
+
+void GlobalTable::assign(const Token& identifier, const Object& value) {
+    auto found = m_Indices.find(identifier.lexeme);
+    if (found == m_Indices.end()) {
+        undefined(identifier);
+    }
+    assign(found->second, identifier, value);
+}
+
+void GlobalTable::undefined(const Token& identifier) {
+    throw RuntimeError(identifier, "Undefined variable '" + identifier.lexeme + "'.");
+}
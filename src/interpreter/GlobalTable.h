@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../lexer/Token.h"
+#include "../util/Object.h"
+
+/* Storage for global variables.
+ *
+ * Every global name gets a dense index the first time the Resolver sees it (as a top-level declaration or as a use that
+ * doesn't resolve to a local), and the value lives in a vector at that index, so reading or assigning a resolved global
+ * is an index instead of a string-keyed hash lookup. A slot exists as soon as the name has an index but only counts as
+ * defined once its declaration has run, which keeps the "Undefined variable" and "Cannot redefine" errors the same as
+ * with an Environment.
+ *
+ * Names the Resolver never saw (e.g. from nodes created by a later pass) go through the name-based slow path.
+ *
+ * Every slot also has a version that changes whenever the slot is written, so a cache of what a global held (see
+ * Call::m_CachedCallee) can tell whether it's still current without reading the value.
+ * */
+class GlobalTable {
+private:
+    std::unordered_map<std::string, int> m_Indices;
+    std::vector<std::string> m_Names;
+    std::vector<Object> m_Values;
+    std::vector<bool> m_Defined;
+    std::vector<uint32_t> m_Versions;
+public:
+    // Returns the index of `name`, reserving a new, still undefined slot the first time the name is seen.
+    int indexOf(const std::string& name);
+
+    void define(int index, const Object& value);
+
+    const Object& get(int index, const Token& identifier) const {
+        if (!m_Defined[index]) {
+            undefined(identifier);
+        }
+        return m_Values[index];
+    }
+
+    void assign(int index, const Token& identifier, const Object& value) {
+        if (!m_Defined[index]) {
+            undefined(identifier);
+        }
+        m_Values[index] = value;
+        m_Versions[index]++;
+    }
+
+    uint32_t version(int index) const {
+        return m_Versions[index];
+    }
+
+    // The value of the global, or nullptr if it isn't defined (yet).
+    const Object* find(int index) const {
+        return m_Defined[index] ? &m_Values[index] : nullptr;
+    }
+
+    // The values by index, for a table no other thread can reach. Slots that aren't defined (yet) hold null.
+    std::vector<Object>& values() { return m_Values; }
+
+    // Slow path by name.
+    const Object& lookup(const Token& identifier) const;
+    void assign(const Token& identifier, const Object& value);
+
+private:
+    [[noreturn]] static void undefined(const Token& identifier);
+};
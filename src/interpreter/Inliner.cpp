@@ -0,0 +1,333 @@
+#include "Inliner.h"
+
+#include <memory>
+#include <utility>
+
+#include "Interpreter.h"
+
+Inliner::Inliner(Interpreter& interpreter, int maxBodySize) : m_Interpreter(interpreter), m_MaxBodySize(maxBodySize) {}
+
+void Inliner::inlineCalls(std::vector<UniqueStmtPtr>& statements) {
+    m_TopLevelDeclarations.clear();
+    m_AssignedNames.clear();
+    m_Inlinable.clear();
+
+    m_Collecting = true;
+    for (auto& statement : statements) {
+        recordTopLevelDeclaration(statement.get());
+        visit(statement);
+    }
+    m_Collecting = false;
+
+    for (auto& statement : statements) {
+        visit(statement);
+
+        auto function = dynamic_cast<Function*>(statement.get());
+        if (function != nullptr && isInlinable(*function)) {
+            m_Inlinable[function->m_Name.lexeme] = function;
+        }
+    }
+}
+
+void Inliner::visit(std::vector<UniqueStmtPtr>& statements) {
+    for (auto& statement : statements) {
+        visit(statement);
+    }
+}
+
+void Inliner::visit(UniqueExprPtr& expr) {
+    if (expr == nullptr) {
+        return;
+    }
+
+    expr->accept(*this);
+    if (m_ExprReplacement != nullptr) {
+        expr = std::move(m_ExprReplacement);
+        m_ExprReplacement = nullptr;
+    }
+}
+
+void Inliner::visit(UniqueStmtPtr& stmt) {
+    if (stmt != nullptr) {
+        stmt->accept(*this);
+    }
+}
+
+void Inliner::recordTopLevelDeclaration(Stmt* stmt) {
+    if (auto function = dynamic_cast<Function*>(stmt)) {
+        m_TopLevelDeclarations[function->m_Name.lexeme]++;
+    } else if (auto let = dynamic_cast<Let*>(stmt)) {
+        m_TopLevelDeclarations[let->m_Name.lexeme]++;
+    } else if (auto clazz = dynamic_cast<Class*>(stmt)) {
+        m_TopLevelDeclarations[clazz->m_Name.lexeme]++;
+    }
+}
+
+bool Inliner::isInlinable(const Function& function) const {
+    const std::string& name = function.m_Name.lexeme;
+    if (m_TopLevelDeclarations.at(name) != 1 || m_AssignedNames.count(name) != 0) {
+        return false;
+    }
+
+    // Calls to a `@memo` function have to go through its cache.
+    if (function.m_MemoCapacity != 0 || function.m_Body.size() != 1) {
+        return false;
+    }
+    auto returnStmt = dynamic_cast<Return*>(function.m_Body.front().get());
+    if (returnStmt == nullptr || !returnStmt->m_Value.has_value()) {
+        return false;
+    }
+
+    int size = inlinableSize(returnStmt->m_Value->get(), function);
+    return size != -1 && size <= m_MaxBodySize;
+}
+
+int Inliner::inlinableSize(const Expr* expr, const Function& function) const {
+    if (dynamic_cast<const Literal*>(expr) != nullptr || dynamic_cast<const Variable*>(expr) != nullptr) {
+        return 1;
+    }
+
+    std::vector<const Expr*> children;
+    if (auto binary = dynamic_cast<const Binary*>(expr)) {
+        children = {binary->m_Left.get(), binary->m_Right.get()};
+    } else if (auto logical = dynamic_cast<const Logical*>(expr)) {
+        children = {logical->m_Left.get(), logical->m_Right.get()};
+    } else if (auto unary = dynamic_cast<const Unary*>(expr)) {
+        children = {unary->m_Right.get()};
+    } else if (auto grouping = dynamic_cast<const Grouping*>(expr)) {
+        children = {grouping->m_Expression.get()};
+    } else if (auto ternary = dynamic_cast<const Ternary*>(expr)) {
+        children = {ternary->m_Expr.get(), ternary->m_TrueExpr.get(), ternary->m_FalseExpr.get()};
+    } else if (auto get = dynamic_cast<const Get*>(expr)) {
+        children = {get->m_Object.get()};
+    } else {
+        return -1;
+    }
+
+    int size = 1;
+    for (const Expr* child : children) {
+        int childSize = inlinableSize(child, function);
+        if (childSize == -1) {
+            return -1;
+        }
+        size += childSize;
+    }
+    return size;
+}
+
+UniqueExprPtr Inliner::substitute(const UniqueExprPtr& expr, const Function& function, const std::vector<UniqueExprPtr>& arguments) const {
+    if (auto variable = dynamic_cast<const Variable*>(expr.get())) {
+        for (size_t i = 0; i < function.m_Params.size(); i++) {
+            if (function.m_Params[i].lexeme == variable->m_VariableName.lexeme) {
+                return arguments[i];
+            }
+        }
+        // Not a parameter, so it's a global. A fresh node has no resolved distance; it keeps the global's slot.
+        auto global = std::make_unique<Variable>(variable->m_VariableName);
+        global->m_GlobalIndex = variable->m_GlobalIndex;
+        return global;
+    }
+    if (dynamic_cast<const Literal*>(expr.get()) != nullptr) {
+        return expr;
+    }
+    if (auto binary = dynamic_cast<const Binary*>(expr.get())) {
+        return std::make_unique<Binary>(substitute(binary->m_Left, function, arguments), binary->m_Operator,
+                                        substitute(binary->m_Right, function, arguments));
+    }
+    if (auto logical = dynamic_cast<const Logical*>(expr.get())) {
+        return std::make_unique<Logical>(substitute(logical->m_Left, function, arguments), logical->m_Operator,
+                                         substitute(logical->m_Right, function, arguments));
+    }
+    if (auto unary = dynamic_cast<const Unary*>(expr.get())) {
+        return std::make_unique<Unary>(unary->m_Operator, substitute(unary->m_Right, function, arguments));
+    }
+    if (auto grouping = dynamic_cast<const Grouping*>(expr.get())) {
+        return std::make_unique<Grouping>(substitute(grouping->m_Expression, function, arguments));
+    }
+    if (auto ternary = dynamic_cast<const Ternary*>(expr.get())) {
+        return std::make_unique<Ternary>(substitute(ternary->m_Expr, function, arguments),
+                                         substitute(ternary->m_TrueExpr, function, arguments),
+                                         substitute(ternary->m_FalseExpr, function, arguments));
+    }
+    auto get = dynamic_cast<const Get*>(expr.get());
+    return std::make_unique<Get>(get->m_Name, substitute(get->m_Object, function, arguments));
+}
+
+// EXPRESSIONS
+
+Object Inliner::visitSetExpr(Set& expr) {
+    visit(expr.m_Object);
+    visit(expr.m_Value);
+    return Object::Null();
+}
+
+Object Inliner::visitLogicalExpr(Logical& expr) {
+    visit(expr.m_Left);
+    visit(expr.m_Right);
+    return Object::Null();
+}
+
+Object Inliner::visitLiteralExpr(Literal&) {
+    return Object::Null();
+}
+
+Object Inliner::visitGroupingExpr(Grouping& expr) {
+    visit(expr.m_Expression);
+    return Object::Null();
+}
+
+Object Inliner::visitCallExpr(Call& expr) {
+    visit(expr.m_Callee);
+    for (auto& argument : expr.m_Arguments) {
+        visit(argument);
+    }
+
+    if (m_Collecting) {
+        return Object::Null();
+    }
+
+    auto callee = dynamic_cast<Variable*>(expr.m_Callee.get());
+    if (callee == nullptr || callee->m_Slot != -1 || callee->m_Upvalue != -1) {
+        return Object::Null();
+    }
+
+    auto candidate = m_Inlinable.find(callee->m_VariableName.lexeme);
+    if (candidate == m_Inlinable.end()) {
+        return Object::Null();
+    }
+
+    const Function& function = *candidate->second;
+    if (function.m_Params.size() != expr.m_Arguments.size()) {
+        // Leave it to the interpreter to report the arity error.
+        return Object::Null();
+    }
+    for (const auto& argument : expr.m_Arguments) {
+        if (dynamic_cast<Literal*>(argument.get()) == nullptr && dynamic_cast<Variable*>(argument.get()) == nullptr) {
+            return Object::Null();
+        }
+    }
+
+    auto returnStmt = dynamic_cast<Return*>(function.m_Body.front().get());
+    // Keep the call's precedence no matter where the body ends up.
+    m_ExprReplacement = std::make_unique<Grouping>(substitute(returnStmt->m_Value.value(), function, expr.m_Arguments));
+    return Object::Null();
+}
+
+Object Inliner::visitAnonFunctionExpr(AnonFunction& expr) {
+    visit(expr.m_Body);
+    return Object::Null();
+}
+
+Object Inliner::visitGetExpr(Get& expr) {
+    visit(expr.m_Object);
+    return Object::Null();
+}
+
+Object Inliner::visitAssignExpr(Assign& expr) {
+    if (m_Collecting) {
+        m_AssignedNames.insert(expr.m_Name.lexeme);
+    }
+    visit(expr.m_Value);
+    return Object::Null();
+}
+
+Object Inliner::visitBinaryExpr(Binary& expr) {
+    visit(expr.m_Left);
+    visit(expr.m_Right);
+    return Object::Null();
+}
+
+Object Inliner::visitThisExpr(This&) {
+    return Object::Null();
+}
+
+Object Inliner::visitSuperExpr(Super&) {
+    return Object::Null();
+}
+
+Object Inliner::visitUnaryExpr(Unary& expr) {
+    visit(expr.m_Right);
+    return Object::Null();
+}
+
+Object Inliner::visitVariableExpr(Variable&) {
+    return Object::Null();
+}
+
+Object Inliner::visitTernaryExpr(Ternary& expr) {
+    visit(expr.m_Expr);
+    visit(expr.m_TrueExpr);
+    visit(expr.m_FalseExpr);
+    return Object::Null();
+}
+
+Object Inliner::visitSpawnExpr(Spawn& expr) {
+    // Not through visitCallExpr(): the call has to stay a call, it isn't evaluated in place.
+    visit(expr.m_Call->m_Callee);
+    for (auto& argument : expr.m_Call->m_Arguments) {
+        visit(argument);
+    }
+    return Object::Null();
+}
+
+Object Inliner::visitAwaitExpr(Await& expr) {
+    visit(expr.m_Future);
+    return Object::Null();
+}
+
+// STATEMENTS
+
+void Inliner::visitExpressionStmt(Expression& stmt) {
+    visit(stmt.m_Expression);
+}
+
+void Inliner::visitReturnStmt(Return& stmt) {
+    if (stmt.m_Value.has_value()) {
+        visit(stmt.m_Value.value());
+    }
+}
+
+void Inliner::visitBreakStmt(Break&) {
+}
+
+void Inliner::visitLetStmt(Let& stmt) {
+    if (stmt.m_Initializer.has_value()) {
+        visit(stmt.m_Initializer.value());
+    }
+}
+
+void Inliner::visitWhileStmt(While& stmt) {
+    visit(stmt.m_Condition);
+    visit(stmt.m_Body);
+}
+
+void Inliner::visitIfStmt(If& stmt) {
+    visit(stmt.m_Condition);
+    visit(stmt.m_ThenBranch);
+    if (stmt.m_ElseBranch.has_value()) {
+        visit(stmt.m_ElseBranch.value());
+    }
+}
+
+void Inliner::visitBlockStmt(Block& stmt) {
+    visit(stmt.m_Statements);
+}
+
+void Inliner::visitFunctionStmt(Function& stmt) {
+    visit(stmt.m_Body);
+}
+
+void Inliner::visitPrintStmt(Print& stmt) {
+    if (stmt.m_Expression.has_value()) {
+        visit(stmt.m_Expression.value());
+    }
+}
+
+void Inliner::visitClazzStmt(Class& stmt) {
+    for (auto& method : stmt.m_Methods) {
+        visit(method->m_Body);
+    }
+    for (auto& staticMethod : stmt.m_StaticMethods) {
+        visit(staticMethod->m_Body);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../parser/Expr.h"
+#include "../parser/Stmt.h"
+#include "../util/Object.h"
+#include "../util/common.h"
+
+class Interpreter;
+
+/* Optimization pass that replaces calls to small helper functions with the helper's body.
+ *
+ * Only top-level `funct` declarations whose whole body is `return <expr>;` are candidates, where <expr> is built from
+ * literals, parameters, globals, operators and property reads (no calls, assignments, `this`, `super` or closures).
+ * Such a function can't recurse, has no locals and can't capture anything, so substituting it only has to deal with
+ * the parameters: every parameter is replaced by the argument expression at the call site, and arguments are limited
+ * to literals and variables, which can be read more than once without changing the result. The argument nodes are
+ * shared, not copied, so they keep the depth and slot the Resolver computed for them, and any other variable in the body
+ * is a global, which keeps its GlobalTable index.
+ *
+ * A call is only inlined when the callee is a global that is declared exactly once, is never assigned to and has
+ * already been declared by the time the call is reached in the top-level statement list.
+ * `@memo` functions are never inlined, their calls have to go through the cache.
+ * */
+class Inliner : public StmtVisitor, public ExprVisitor<Object> {
+private:
+    Interpreter& m_Interpreter;
+
+    // Max number of AST nodes in the body of an inlined function.
+    int m_MaxBodySize;
+
+    // While collecting, the pass only records facts about the program and doesn't rewrite anything.
+    bool m_Collecting = false;
+    std::unordered_map<std::string, int> m_TopLevelDeclarations;
+    std::unordered_set<std::string> m_AssignedNames;
+
+    // Inlinable functions declared so far, by name.
+    std::unordered_map<std::string, const Function*> m_Inlinable;
+
+    UniqueExprPtr m_ExprReplacement;
+public:
+    explicit Inliner(Interpreter& interpreter, int maxBodySize = 16);
+
+    void inlineCalls(std::vector<UniqueStmtPtr>& statements);
+
+    Object visitSetExpr(Set& expr) override;
+    Object visitLogicalExpr(Logical& expr) override;
+    Object visitLiteralExpr(Literal& expr) override;
+    Object visitGroupingExpr(Grouping& expr) override;
+    Object visitCallExpr(Call& expr) override;
+    Object visitAnonFunctionExpr(AnonFunction& expr) override;
+    Object visitGetExpr(Get& expr) override;
+    Object visitAssignExpr(Assign& expr) override;
+    Object visitBinaryExpr(Binary& expr) override;
+    Object visitThisExpr(This& expr) override;
+    Object visitSuperExpr(Super& expr) override;
+    Object visitUnaryExpr(Unary& expr) override;
+    Object visitVariableExpr(Variable& expr) override;
+    Object visitTernaryExpr(Ternary& expr) override;
+    Object visitSpawnExpr(Spawn& expr) override;
+    Object visitAwaitExpr(Await& expr) override;
+
+    void visitExpressionStmt(Expression& stmt) override;
+    void visitReturnStmt(Return& stmt) override;
+    void visitBreakStmt(Break& stmt) override;
+    void visitLetStmt(Let& stmt) override;
+    void visitWhileStmt(While& stmt) override;
+    void visitIfStmt(If& stmt) override;
+    void visitBlockStmt(Block& stmt) override;
+    void visitFunctionStmt(Function& stmt) override;
+    void visitPrintStmt(Print& stmt) override;
+    void visitClazzStmt(Class& stmt) override;
+
+private:
+    void visit(std::vector<UniqueStmtPtr>& statements);
+    void visit(UniqueExprPtr& expr);
+    void visit(UniqueStmtPtr& stmt);
+
+    void recordTopLevelDeclaration(Stmt* stmt);
+    bool isInlinable(const Function& function) const;
+
+    // Returns the number of nodes in `expr`, or -1 if it contains a node that can't be inlined.
+    int inlinableSize(const Expr* expr, const Function& function) const;
+
+    UniqueExprPtr substitute(const UniqueExprPtr& expr, const Function& function, const std::vector<UniqueExprPtr>& arguments) const;
+};
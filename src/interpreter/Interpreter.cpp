@@ -3,18 +3,24 @@
 #include <cassert>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <sstream>
 
 #include "KarolaScriptClass.h"
 #include "RuntimeError.h"
+#include "../util/Concurrency.h"
 #include "../util/ErrorReporter.h"
 #include "KarolaScriptFunction.h"
 #include "KarolaScriptCallable.h"
 #include "../util/Utils.h"
 #include "ks_stdlib/StdLibFunctions.h"
 #include "KarolaScriptAnonFunction.h"
+#include "KarolaScriptFuture.h"
+#include "MessageCopier.h"
+#include "Operators.h"
+#include "TaskPool.h"
 
 Interpreter::Interpreter() {
     globals = std::make_unique<Environment>();
@@ -22,7 +28,18 @@ Interpreter::Interpreter() {
     loadNativeFunctions();
 }
 
+Interpreter::Interpreter(const Interpreter& parent) : globalTable(parent.globalTable) {
+    globals = std::make_shared<Environment>();
+    environment = globals;
+    budget.share(parent.budget);
+}
+
+void Interpreter::setLimits(const ExecutionLimits& limits) {
+    budget.configure(limits);
+}
+
 void Interpreter::interpret(std::vector<UniqueStmtPtr>& statements) {
+    budget.start();
     try {
         for (auto& statement : statements) {
             execute(statement.get());
@@ -30,17 +47,26 @@ void Interpreter::interpret(std::vector<UniqueStmtPtr>& statements) {
     } catch (RuntimeError& error) {
         ErrorReporter::runtimeError(error);
     }
-}
-
-void Interpreter::resolve(Expr* expr, int depth) {
-    localsDistances[expr] = depth;
+    // Spawned tasks nobody awaited still run to the end.
+    if (concurrency::active()) {
+        TaskPool::getInstance().runUntil([] { return !concurrency::active(); });
+    }
 }
 
 Object Interpreter::evaluate(Expr* expr) {
+    budget.tick();
+    if (expr->m_Handler != nullptr) {
+        return expr->m_Handler(*this, *expr);
+    }
     return expr->accept(*this);
 }
 
 void Interpreter::execute(Stmt* stmt) {
+    budget.tick();
+    if (stmt->m_Handler != nullptr) {
+        stmt->m_Handler(*this, *stmt);
+        return;
+    }
     stmt->accept(*this);
 }
 
@@ -49,9 +75,37 @@ void Interpreter::executeBlock(const std::vector<UniqueStmtPtr>& statements, std
     EnvironmentGuard environment_guard{*this, std::move(enclosing_env)};
     for (auto& statement : statements) {
         execute(statement.get());
+        if (completion != COMPLETION_NORMAL) {
+            return;
+        }
     }
 }
 
+Object Interpreter::runFrame(KarolaScriptCallable& callee, std::shared_ptr<Environment> frame) {
+    Object result = callee.run(*this, std::move(frame));
+    if (completion == COMPLETION_TAIL_CALL) {
+        return runTailCalls();
+    }
+    return result;
+}
+
+Object Interpreter::runTailCalls() {
+    // By the time we get here the function that made the tail call has already returned, so every iteration of this
+    // loop reuses the same native stack depth.
+    Object result;
+    while (completion == COMPLETION_TAIL_CALL) {
+        completion = COMPLETION_NORMAL;
+        SharedCallablePtr callee = std::move(tailCallee);
+        result = callee->run(*this, std::move(tailFrame));
+    }
+    return result;
+}
+
+std::shared_ptr<Environment> Interpreter::newEnvironment(size_t frameSize) {
+    budget.charge(sizeof(Environment));
+    return std::make_shared<Environment>(frameSize);
+}
+
 bool Interpreter::isTruthy(const Object& object) const {
     if (object.isNull()) {
         return false;
@@ -74,6 +128,14 @@ bool Interpreter::isEqual(const Object& lhs, const Object& rhs) const {
         return false;
     }
 
+    // Integers and doubles are the same type as far as the language is concerned.
+    if (lhs.isNumber() && rhs.isNumber()) {
+        if (lhs.isInteger() && rhs.isInteger()) {
+            return lhs.getInteger() == rhs.getInteger();
+        }
+        return lhs.getNumber() == rhs.getNumber();
+    }
+
     if (lhs.type != rhs.type) {
         return false;
     }
@@ -82,10 +144,6 @@ bool Interpreter::isEqual(const Object& lhs, const Object& rhs) const {
         return lhs.getBoolean() == rhs.getBoolean();
     }
 
-    if (lhs.isNumber()) {
-        return lhs.getNumber() == rhs.getNumber();
-    }
-
     if (lhs.isString()) {
         return lhs.getString() == rhs.getString();
     }
@@ -118,14 +176,11 @@ std::string Interpreter::stringify(const Object& object) {
         case ObjType::OBJTYPE_BOOL:
             return (object.getBoolean() ? std::string("true") : std::string("false"));
         case ObjType::OBJTYPE_NUMBER:
-            if (std::abs(floor(object.getNumber())) == std::abs(object.getNumber())){ //If it has no decimal part
-                return std::to_string((long long) object.getNumber());
-            } else {
-                return std::to_string(object.getNumber());
-            }
+        case ObjType::OBJTYPE_INTEGER:
+            return utils::numberToString(object.getNumber());
         case ObjType::OBJTYPE_STRING:
         {
-            std::string s = object.getString();
+            std::string s = object.getString().str();
             utils::replaceAll(s, "\\n", "\n");
             utils::replaceAll(s, "\\t", "\t");
             return s;
@@ -134,6 +189,8 @@ std::string Interpreter::stringify(const Object& object) {
             return object.getCallable()->toString();
         case ObjType::OBJTYPE_INSTANCE:
             return object.getClassInstance()->toString();
+        case ObjType::OBJTYPE_FUTURE:
+            return object.getFuture()->toString();
         default:
             throw std::runtime_error("Object has no string representation");
     }
@@ -145,10 +202,12 @@ void Interpreter::loadNativeFunctions() {
     SharedCallablePtr input = std::make_shared<stdlibFunctions::Input>();
     SharedCallablePtr toUpper = std::make_shared<stdlibFunctions::ToUpper>();
     SharedCallablePtr toLower = std::make_shared<stdlibFunctions::ToLower>();
+    SharedCallablePtr parallelFor = std::make_shared<stdlibFunctions::ParallelFor>();
 
-    std::vector<Object> functions = {Object(clock), Object(sleep), Object(input), Object(toUpper), Object(toLower)};
+    std::vector<Object> functions = {Object(clock), Object(sleep), Object(input), Object(toUpper), Object(toLower),
+                                     Object(parallelFor)};
     for (const auto &function : functions) {
-        globals->define(function.getCallable()->name(), function);
+        globalTable.define(globalTable.indexOf(function.getCallable()->name()), function);
     }
 
     /**
@@ -162,14 +221,33 @@ void Interpreter::loadNativeFunctions() {
     staticMethods["sqrr00t"] = Object(sqrr00t);
     SharedCallablePtr mathClazz(KarolaScriptMetaClass::createClass("Math", nullptr, {}, staticMethods));
     Object classObject(mathClazz);
-    environment->define("Math", classObject);
+    globalTable.define(globalTable.indexOf("Math"), classObject);
+}
+
+void Interpreter::define(int slot, int globalIndex, bool captured, const Object& value) {
+    if (globalIndex != -1) {
+        globalTable.define(globalIndex, value);
+    } else if (captured) {
+        environment->defineCell(slot, value);
+    } else {
+        environment->define(slot, value);
+    }
 }
 
-Object Interpreter::lookupVariable(const Token& identifier, const Expr* variableExpr) {
-    if (localsDistances.find(variableExpr) != localsDistances.end()){
-        return environment->getAt(localsDistances[variableExpr], identifier.lexeme);
+std::vector<SharedCellPtr> Interpreter::captureUpvalues(const std::vector<UpvalueSource>& sources) {
+    std::vector<SharedCellPtr> upvalues;
+    upvalues.reserve(sources.size());
+    for (const UpvalueSource& source : sources) {
+        if (!source.isLocal) {
+            upvalues.push_back((*environment->m_Upvalues)[source.index]);
+        } else if (source.byValue) {
+            budget.charge(sizeof(Object));
+            upvalues.push_back(std::make_shared<Object>(environment->get(source.slot)));
+        } else {
+            upvalues.push_back(environment->cell(source.slot));
+        }
     }
-    return globals->lookup(identifier);
+    return upvalues;
 }
 
 // EXPRESSIONS
@@ -182,6 +260,7 @@ Object Interpreter::visitSetExpr(Set& expr) {
     }
 
     Object value = evaluate(expr.m_Value.get());
+    budget.charge(sizeof(Object));
     object.getClassInstance()->setProperty(expr.m_Name, value);
     return value;
 }
@@ -216,62 +295,227 @@ Object Interpreter::visitGroupingExpr(Grouping& expr) {
 }
 
 Object Interpreter::visitCallExpr(Call& callExpr) {
-    Object callee = evaluate(callExpr.m_Callee.get());
-
-    std::vector<Object> arguments;
-    for (const UniqueExprPtr &arg : callExpr.m_Arguments) {
-        Object argObject = evaluate(arg.get());
-        if (argObject.isAnonFunction()) {
-            KarolaScriptFunction* ksFunction = dynamic_cast<KarolaScriptFunction *>(callee.getCallable().get());
-            environment->define(ksFunction->m_Declaration->m_Name.lexeme, argObject);
-            arguments.push_back(argObject);
+    // The global callee still holds the callable called last time, so the cached entry still applies.
+    if (callExpr.m_CalleeGlobal != -1 && callExpr.m_CachedEntry != nullptr &&
+        globalTable.version(callExpr.m_CalleeGlobal) == callExpr.m_CachedVersion) {
+        // Held for the duration of the call, since the call can reassign the global and refill the cache.
+        SharedCallablePtr callee = callExpr.m_CachedCallee;
+        return callExpr.m_CachedEntry(*this, callee, callExpr);
+    }
+
+    return callValue(callExpr, evaluate(callExpr.m_Callee.get()));
+}
+
+Object Interpreter::callValue(Call& callExpr, const Object& callee) {
+    if (callee.isCallable() || callee.isAnonFunction()) {
+        const SharedCallablePtr& callable = callee.getCallable();
+        if (concurrency::active()) {
+            // Other threads may be reading the cache, so it's left as it is.
+            CallEntry entry = callable == callExpr.m_CachedCallee ? callExpr.m_CachedEntry
+                                                                  : selectCallEntry(*callable, callExpr);
+            if (entry != nullptr) {
+                return entry(*this, callable, callExpr);
+            }
         } else {
-            arguments.push_back(argObject);
+            if (callable != callExpr.m_CachedCallee) {
+                callExpr.m_CachedCallee = callable;
+                callExpr.m_CachedEntry = selectCallEntry(*callable, callExpr);
+            }
+            if (callExpr.m_CalleeGlobal != -1) {
+                callExpr.m_CachedVersion = globalTable.version(callExpr.m_CalleeGlobal);
+            }
+            if (callExpr.m_CachedEntry != nullptr) {
+                return callExpr.m_CachedEntry(*this, callable, callExpr);
+            }
         }
     }
 
+    // Not callable, or the wrong number of arguments: reported after evaluating the arguments.
+    for (const auto& argument : callExpr.m_Arguments) {
+        evaluate(argument.get());
+    }
     if (!callee.isCallable() && !callee.isAnonFunction()) {
         throw RuntimeError("Expression is not callable", callExpr.m_Paren.line);
     }
-    KarolaScriptCallable* callable = callee.getCallable().get();
-    if (arguments.size() != callable->arity()) {
-        std::stringstream ss;
-        ss  << callable->name() << " expected " << callable->arity() << " argument(s) but instead got " << arguments.size();
-        throw RuntimeError(ss.str(), callExpr.m_Paren.line);
+    const SharedCallablePtr& callable = callee.getCallable();
+    std::stringstream ss;
+    ss  << callable->name() << " expected " << callable->arity() << " argument(s) but instead got " << callExpr.m_Arguments.size();
+    throw RuntimeError(ss.str(), callExpr.m_Paren.line);
+}
+
+CallEntry Interpreter::selectCallEntry(KarolaScriptCallable& callable, const Call& callExpr) {
+    if (static_cast<size_t>(callable.arity()) != callExpr.m_Arguments.size()) {
+        return nullptr;
     }
 
-    return callable->call(*this, arguments);
+    // Script functions and constructors: the arguments are evaluated straight into the parameter slots of the frame
+    // the call runs in.
+    switch (callable.m_Type) {
+        case KarolaScriptCallable::FUNCTION:
+            return &Interpreter::callInFrameEntry<KarolaScriptFunction>;
+        case KarolaScriptCallable::ANON_FUNCTION:
+            return &Interpreter::callInFrameEntry<KarolaScriptAnonFunction>;
+        case KarolaScriptCallable::CLASS:
+            if (callExpr.m_NonEscaping) {
+                return &Interpreter::constructRecycled;
+            }
+            if (static_cast<KarolaScriptClass&>(callable).hasInitializer()) {
+                return &Interpreter::callInFrameEntry<KarolaScriptClass>;
+            }
+            return &Interpreter::callWithArguments;
+        case KarolaScriptCallable::NATIVE:
+            return &Interpreter::callWithArguments;
+    }
+    return nullptr;
+}
+
+template<typename Callee>
+Object Interpreter::callInFrameEntry(Interpreter& interpreter, const SharedCallablePtr& callee, Call& callExpr) {
+    return interpreter.callInFrame(static_cast<Callee&>(*callee), callee, callExpr);
+}
+
+Object Interpreter::callWithArguments(Interpreter& interpreter, const SharedCallablePtr& callee, Call& callExpr) {
+    const std::vector<UniqueExprPtr>& argumentExprs = callExpr.m_Arguments;
+
+    // Natives get the arguments in a buffer on the native stack when there are only a few of them.
+    constexpr size_t INLINE_ARGUMENTS = 4;
+    Object inlineArguments[INLINE_ARGUMENTS];
+    std::vector<Object> spilledArguments;
+    Object* arguments = inlineArguments;
+    if (argumentExprs.size() > INLINE_ARGUMENTS) {
+        spilledArguments.resize(argumentExprs.size());
+        arguments = spilledArguments.data();
+    }
+    for (size_t i = 0; i < argumentExprs.size(); i++) {
+        arguments[i] = interpreter.evaluate(argumentExprs[i].get());
+    }
+
+    return callee->call(interpreter, Arguments(arguments, argumentExprs.size()));
+}
+
+namespace {
+// A class constructing into the instance its call site recycles, for callInFrame().
+struct RecyclingConstructor {
+    KarolaScriptClass& klass;
+    SharedInstancePtr& recycled;
+
+    std::shared_ptr<Environment> newFrame(Interpreter& interpreter, int& firstParameter) {
+        return klass.newFrame(interpreter, recycled, firstParameter);
+    }
+
+    Object run(Interpreter& interpreter, std::shared_ptr<Environment> frame) {
+        return klass.run(interpreter, std::move(frame));
+    }
+};
+}
+
+Object Interpreter::constructRecycled(Interpreter& interpreter, const SharedCallablePtr& callee, Call& callExpr) {
+    auto& klass = static_cast<KarolaScriptClass&>(*callee);
+    if (concurrency::active()) {
+        // The call site's instance is shared by every thread running it.
+        if (!klass.hasInitializer()) {
+            return callWithArguments(interpreter, callee, callExpr);
+        }
+        return interpreter.callInFrame(klass, callee, callExpr);
+    }
+    if (!klass.hasInitializer()) {
+        return Object(klass.newInstance(interpreter, callExpr.m_RecycledInstance));
+    }
+    RecyclingConstructor constructor{klass, callExpr.m_RecycledInstance};
+    return interpreter.callInFrame(constructor, callee, callExpr);
+}
+
+template<typename Callee>
+Object Interpreter::callInFrame(Callee& callable, const SharedCallablePtr& callee, Call& callExpr) {
+    int firstParameter;
+    std::shared_ptr<Environment> frame = callable.newFrame(*this, firstParameter);
+    for (size_t i = 0; i < callExpr.m_Arguments.size(); i++) {
+        frame->m_Slots[firstParameter + i] = evaluate(callExpr.m_Arguments[i].get());
+    }
+    if (callExpr.m_IsTailCall) {
+        tailCallee = callee;
+        tailFrame = std::move(frame);
+        completion = COMPLETION_TAIL_CALL;
+        return Object::Null();
+    }
+
+    Object result = callable.run(*this, std::move(frame));
+    if (completion == COMPLETION_TAIL_CALL) {
+        return runTailCalls();
+    }
+    return result;
 }
 
 Object Interpreter::visitAnonFunctionExpr(AnonFunction& expr) {
-    SharedCallablePtr anonFunction = std::make_shared<KarolaScriptAnonFunction>(&expr, environment);
+    budget.charge(sizeof(KarolaScriptAnonFunction));
+    SharedCallablePtr anonFunction = std::make_shared<KarolaScriptAnonFunction>(&expr, captureUpvalues(expr.m_Upvalues));
     Object anonFunctionObject(anonFunction);
     return anonFunctionObject;
 }
 
 Object Interpreter::visitGetExpr(Get& expr) {
-    Object object = evaluate(expr.m_Object.get());
+    return getProperty(expr, evaluate(expr.m_Object.get()));
+}
 
+Object Interpreter::getProperty(Get& expr, const Object& object) {
     // lookup static methods within the class first before looking at instance methods
     if (object.isCallable() && object.getCallable()->m_Type == KarolaScriptCallable::CLASS) {
-        KarolaScriptClass* clazz = dynamic_cast<KarolaScriptClass*>(object.getCallable().get());
+        auto* clazz = static_cast<KarolaScriptClass*>(object.getCallable().get());
         return clazz->getProperty(expr.m_Name);
     }
     if (object.isInstance()) {
-        return object.getClassInstance()->getProperty(expr.m_Name);
+        SharedInstancePtr instance = object.getClassInstance();
+
+        // Fields shadow methods.
+        Object field;
+        if (instance->findField(expr.m_Name.lexeme, field)) {
+            return field;
+        }
+        KarolaScriptFunction* method = findMethod(expr, *instance->getClass());
+
+        // Create a new function where the variable "this" is bound to this instance.
+        SharedCallablePtr boundMethod(method->bind(std::move(instance)));
+        return Object(boundMethod);
     }
 
     throw RuntimeError(expr.m_Name, "Only instances have properties.");
 }
 
+KarolaScriptFunction* Interpreter::findMethod(Get& expr, KarolaScriptClass& klass) {
+    if (expr.m_CachedClassId == klass.m_Id) {
+        return expr.m_CachedMethod;
+    }
+
+    const Object* found = klass.findMethod(expr.m_NameId);
+    if (found == nullptr) {
+        throw RuntimeError(expr.m_Name, "Undefined property '" + expr.m_Name.lexeme + "'.");
+    }
+    auto* method = static_cast<KarolaScriptFunction*>(found->getCallable().get());
+    if (!concurrency::active()) {
+        expr.m_CachedClassId = klass.m_Id;
+        expr.m_CachedMethod = method;
+    }
+    return method;
+}
+
 Object Interpreter::visitAssignExpr(Assign& expr) {
     Object value = evaluate(expr.m_Value.get());
 
-    auto distance = localsDistances.find(&expr);
-    if (distance != localsDistances.end()) {
-        environment->assignAt(distance->second, expr.m_Name, value);
+    if (expr.m_GlobalIndex != -1) {
+        globalTable.assign(expr.m_GlobalIndex, expr.m_Name, value);
+        return value;
+    }
+
+    if (expr.m_Slot != -1) {
+        if (expr.m_InCell) {
+            *environment->cell(expr.m_Slot) = value;
+        } else {
+            environment->define(expr.m_Slot, value);
+        }
+    } else if (expr.m_Upvalue != -1) {
+        environment->upvalue(expr.m_Upvalue) = value;
     } else {
-        globals->assign(expr.m_Name, value);
+        globalTable.assign(expr.m_Name, value);
     }
     return value;
 }
@@ -284,100 +528,141 @@ Object Interpreter::visitBinaryExpr(Binary& expr) {
     // Check the type of the operator.
     switch (expr.m_Operator.type) {
         case TOKEN_MINUS:
-            checkNumberOperands(expr.m_Operator, left, right);
-            return Object(left.getNumber() - right.getNumber());
-
+            return operators::binary<TOKEN_MINUS>(*this, expr.m_Operator, left, right);
         case TOKEN_SLASH:
-            checkNumberOperands(expr.m_Operator, left, right);
-
-            // Throw error if right operand is 0.
-            if (right.getNumber() == 0) {
-                throw RuntimeError(expr.m_Operator, "Division by 0.");
-            }
-            return Object(left.getNumber() / right.getNumber());;
-
+            return operators::binary<TOKEN_SLASH>(*this, expr.m_Operator, left, right);
         case TOKEN_STAR:
-            checkNumberOperands(expr.m_Operator, left, right);
-            return Object(left.getNumber() * right.getNumber());
-
+            return operators::binary<TOKEN_STAR>(*this, expr.m_Operator, left, right);
         case TOKEN_GREATER:
-            checkNumberOperands(expr.m_Operator, left, right);
-            return Object(left.getNumber() > right.getNumber());
-
+            return operators::binary<TOKEN_GREATER>(*this, expr.m_Operator, left, right);
         case TOKEN_GREATER_EQUAL:
-            checkNumberOperands(expr.m_Operator, left, right);
-            return Object(left.getNumber() >= right.getNumber());
-
+            return operators::binary<TOKEN_GREATER_EQUAL>(*this, expr.m_Operator, left, right);
         case TOKEN_LESS:
-            checkNumberOperands(expr.m_Operator, left, right);
-            return Object(left.getNumber() < right.getNumber());
-
+            return operators::binary<TOKEN_LESS>(*this, expr.m_Operator, left, right);
         case TOKEN_LESS_EQUAL:
-            checkNumberOperands(expr.m_Operator, left, right);
-            return Object(left.getNumber() <= right.getNumber());
-
+            return operators::binary<TOKEN_LESS_EQUAL>(*this, expr.m_Operator, left, right);
         case TOKEN_EQUAL_EQUAL:
-            return Object(isEqual(left, right));
-
+            return operators::binary<TOKEN_EQUAL_EQUAL>(*this, expr.m_Operator, left, right);
         case TOKEN_BANG_EQUAL:
-            return Object(!isEqual(left, right));
-
+            return operators::binary<TOKEN_BANG_EQUAL>(*this, expr.m_Operator, left, right);
         case TOKEN_PLUS:
-            if (left.isString() && right.isString()) {
-                return Object(left.getString() + right.getString());
-            }
-            else if (left.isNumber() && right.isNumber()) {
-                return Object(left.getNumber() + right.getNumber());
-            }
-            else if (left.isNumber() && right.isString()) {
-                // Remove trailing zeroes.
-                std::string num_as_string = std::to_string(left.getNumber());
-                num_as_string.erase(num_as_string.find_last_not_of('0') + 1, std::string::npos);
-                num_as_string.erase(num_as_string.find_last_not_of('.') + 1, std::string::npos);
-                return Object(num_as_string + right.getString());
-            }
-            else if (left.isString() && right.isNumber()) {
-                // Remove trailing zeroes.
-                std::string num_as_string = std::to_string(right.getNumber());
-                num_as_string.erase(num_as_string.find_last_not_of('0') + 1, std::string::npos);
-                num_as_string.erase(num_as_string.find_last_not_of('.') + 1, std::string::npos);
-                return Object(left.getString() + num_as_string);
-            }
-
-            throw RuntimeError(expr.m_Operator, "Operands must be of type string or number.");
-
+            return operators::binary<TOKEN_PLUS>(*this, expr.m_Operator, left, right);
         default:
             return {};
     }
 }
 
 Object Interpreter::visitThisExpr(This& expr) {
-    return lookupVariable(expr.m_Keyword, &expr);
+    if (expr.m_Upvalue != -1) {
+        return environment->upvalue(expr.m_Upvalue);
+    }
+    return environment->get(0);
 }
 
 Object Interpreter::visitSuperExpr(Super& expr) {
-//    int distance = localsDistances[&expr]; // distance from current env to env where the superclass is stored
-    // Get the superclass object and cast it to KarolaScriptClass
-//    Object superclassObject = environment->getAt(distance, "super");
-    Object superclassObject = environment->lookup("super");
-    KarolaScriptClass* superclass = dynamic_cast<KarolaScriptClass*>(superclassObject.getCallable().get());
-
-    // "this" is always one level nearer than "super"'s environment.
-    Object instanceObject = environment->lookup("this");
-
-    std::optional<Object> methodObj = superclass->findMethod(expr.m_Method.lexeme);
-    if (!methodObj.has_value()){
-        throw RuntimeError("Undefined property '" + expr.m_Method.lexeme + "'.", expr.m_Keyword.line);
-    }
-    KarolaScriptFunction* method = dynamic_cast<KarolaScriptFunction*>(methodObj.value().getCallable().get());
+    KarolaScriptFunction* method = findSuperMethod(expr);
 
     //Bind "this" to the superclass' method. Even though the method comes from the superclass, "this" refers to the instance that is
     //calling the method.
-    SharedCallablePtr bindedMethod(method->bind(instanceObject.getClassInstance()));
+    SharedCallablePtr bindedMethod(method->bind(superReceiver(expr)));
     Object bindedMethodObj(bindedMethod);
     return bindedMethodObj;
 }
 
+Object Interpreter::callMethod(Call& callExpr) {
+    auto& getExpr = static_cast<Get&>(*callExpr.m_Callee);
+    Object object = evaluate(getExpr.m_Object.get());
+    if (!object.isInstance()) {
+        return callValue(callExpr, getProperty(getExpr, object));
+    }
+    SharedInstancePtr instance = object.getClassInstance();
+    Object field;
+    if (instance->findField(getExpr.m_Name.lexeme, field)) {
+        return callValue(callExpr, field);
+    }
+
+    // The method comes from the Get's cache, which holds neither the method nor the receiver, so the call site keeps
+    // nothing alive between calls.
+    KarolaScriptClass& klass = *instance->getClass();
+    KarolaScriptFunction* method = findMethod(getExpr, klass);
+    if (callExpr.m_Arguments.size() != static_cast<size_t>(method->arity())) {
+        for (const UniqueExprPtr &arg : callExpr.m_Arguments) {
+            evaluate(arg.get());
+        }
+        std::stringstream ss;
+        ss  << method->name() << " expected " << method->arity() << " argument(s) but instead got " << callExpr.m_Arguments.size();
+        throw RuntimeError(ss.str(), callExpr.m_Paren.line);
+    }
+
+    int firstParameter;
+    std::shared_ptr<Environment> frame = method->newFrame(*this, instance, firstParameter);
+    for (size_t i = 0; i < callExpr.m_Arguments.size(); i++) {
+        frame->m_Slots[firstParameter + i] = evaluate(callExpr.m_Arguments[i].get());
+    }
+    if (callExpr.m_IsTailCall) {
+        // The pending call owns its callee, which the method table it was found in shares.
+        tailCallee = klass.findMethod(getExpr.m_NameId)->getCallable();
+        tailFrame = std::move(frame);
+        completion = COMPLETION_TAIL_CALL;
+        return Object::Null();
+    }
+    return runFrame(*method, std::move(frame));
+}
+
+Object Interpreter::callSuperMethod(Call& callExpr) {
+    auto& superExpr = static_cast<Super&>(*callExpr.m_Callee);
+    KarolaScriptFunction* method = findSuperMethod(superExpr);
+    SharedInstancePtr instance = superReceiver(superExpr);
+
+    if (callExpr.m_Arguments.size() != static_cast<size_t>(method->arity())) {
+        for (const UniqueExprPtr &arg : callExpr.m_Arguments) {
+            evaluate(arg.get());
+        }
+        std::stringstream ss;
+        ss  << method->name() << " expected " << method->arity() << " argument(s) but instead got " << callExpr.m_Arguments.size();
+        throw RuntimeError(ss.str(), callExpr.m_Paren.line);
+    }
+
+    int firstParameter;
+    std::shared_ptr<Environment> frame = method->newFrame(*this, instance, firstParameter);
+    for (size_t i = 0; i < callExpr.m_Arguments.size(); i++) {
+        frame->m_Slots[firstParameter + i] = evaluate(callExpr.m_Arguments[i].get());
+    }
+    return runFrame(*method, std::move(frame));
+}
+
+KarolaScriptFunction* Interpreter::findSuperMethod(Super& expr) {
+    // Methods capture the superclass when they're created.
+    const Object& superclassObject = environment->upvalue(expr.m_Upvalue);
+    auto* superclass = static_cast<KarolaScriptClass*>(superclassObject.getCallable().get());
+
+    if (expr.m_CachedClassId == superclass->m_Id) {
+        return expr.m_CachedMethod;
+    }
+
+    const Object* found = superclass->findMethod(expr.m_MethodId);
+    if (found == nullptr) {
+        throw RuntimeError("Undefined property '" + expr.m_Method.lexeme + "'.", expr.m_Keyword.line);
+    }
+    auto* method = static_cast<KarolaScriptFunction*>(found->getCallable().get());
+    if (!concurrency::active()) {
+        expr.m_CachedClassId = superclass->m_Id;
+        expr.m_CachedMethod = method;
+    }
+    return method;
+}
+
+SharedInstancePtr Interpreter::superReceiver(const Super& expr) {
+    if (expr.m_InMethod) {
+        return environment->get(0).getClassInstance();
+    }
+    if (expr.m_ThisUpvalue != -1) {
+        return environment->upvalue(expr.m_ThisUpvalue).getClassInstance();
+    }
+    // Static methods can see "super" but have no "this".
+    throw RuntimeError("Cannot use 'super' outside of an instance method.", expr.m_Keyword.line);
+}
+
 Object Interpreter::visitUnaryExpr(Unary& expr) {
     // Evaluate the right-hand side operand of the unary expression.
     Object right = evaluate(expr.m_Right.get());
@@ -386,14 +671,10 @@ Object Interpreter::visitUnaryExpr(Unary& expr) {
     switch (expr.m_Operator.type)
     {
         case TokenType::TOKEN_MINUS:
-            // Ensure that the right-hand side operand is a number.
-            checkNumberOperand(expr.m_Operator, right);
-            // Return the negation of the right-hand side operand.
-            return Object(-right.getNumber());
+            return operators::unary<TOKEN_MINUS>(*this, expr.m_Operator, right);
 
         case TokenType::TOKEN_BANG:
-            // Return the negation of the truthiness of the right-hand side operand.
-            return Object(!isTruthy(right));
+            return operators::unary<TOKEN_BANG>(*this, expr.m_Operator, right);
 
         default:
             return Object::Null(); // Unreachable.
@@ -401,7 +682,20 @@ Object Interpreter::visitUnaryExpr(Unary& expr) {
 }
 
 Object Interpreter::visitVariableExpr(Variable& expr) {
-    return lookupVariable(expr.m_VariableName, &expr);
+    if (expr.m_GlobalIndex != -1) {
+        return globalTable.get(expr.m_GlobalIndex, expr.m_VariableName);
+    }
+    if (expr.m_Slot != -1) {
+        if (expr.m_InCell) {
+            return *environment->cell(expr.m_Slot);
+        }
+        return environment->get(expr.m_Slot);
+    }
+    if (expr.m_Upvalue != -1) {
+        return environment->upvalue(expr.m_Upvalue);
+    }
+    // A global the Resolver never saw.
+    return globalTable.lookup(expr.m_VariableName);
 }
 
 Object Interpreter::visitTernaryExpr(Ternary& expr) {
@@ -414,6 +708,79 @@ Object Interpreter::visitTernaryExpr(Ternary& expr) {
     return right;
 }
 
+Object Interpreter::visitSpawnExpr(Spawn& expr) {
+    const Call& callExpr = *expr.m_Call;
+    Object callee = evaluate(callExpr.m_Callee.get());
+    std::vector<Object> arguments;
+    arguments.reserve(callExpr.m_Arguments.size());
+    for (const auto& argument : callExpr.m_Arguments) {
+        arguments.push_back(evaluate(argument.get()));
+    }
+
+    if (!callee.isCallable() && !callee.isAnonFunction()) {
+        throw RuntimeError(expr.m_Keyword, "Can only spawn calls to functions and classes.");
+    }
+    SharedCallablePtr callable = callee.getCallable();
+    if (static_cast<size_t>(callable->arity()) != arguments.size()) {
+        std::stringstream ss;
+        ss  << callable->name() << " expected " << callable->arity() << " argument(s) but instead got " << arguments.size();
+        throw RuntimeError(ss.str(), callExpr.m_Paren.line);
+    }
+    // The task only ever writes what it creates itself, and gets its own copy of everything else it can reach, the
+    // globals included, so whatever it reads stays the same while it runs.
+    std::string sharedWrite = callable->sharedWrite();
+    if (!sharedWrite.empty()) {
+        throw RuntimeError(expr.m_Keyword, "Spawned function can't write state other code can see, but " + sharedWrite + ".");
+    }
+
+    // The task runs on an interpreter of its own, drawing on this one's budget.
+    auto worker = std::make_shared<Interpreter>(*this);
+    std::vector<Object>& globalValues = worker->getGlobals().values();
+    budget.charge(sizeof(KarolaScriptFuture) + sizeof(Interpreter) + globalValues.size() * sizeof(Object));
+    // One copier for all of it, so a global passed as an argument is still the same value as the global.
+    MessageCopier copier(*this);
+    Object function = copier.copy(callee);
+    for (Object& argument : arguments) {
+        argument = copier.copy(argument);
+    }
+    for (Object& value : globalValues) {
+        value = copier.copy(value);
+    }
+
+    auto future = std::make_shared<KarolaScriptFuture>();
+    auto scope = std::make_shared<concurrency::TaskScope>();
+    TaskPool::getInstance().submit([future, function, arguments, worker, scope]() mutable {
+        Object result;
+        std::exception_ptr error;
+        try {
+            result = function.getCallable()->call(*worker, Arguments(arguments));
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // Whatever the task still holds has to go before it stops counting as running. The worker goes before the
+        // future is done, so the steps it took are on the budget by the time `await` returns.
+        function = Object::Null();
+        arguments.clear();
+        worker.reset();
+        if (error) {
+            future->fail(error);
+        } else {
+            future->resolve(result);
+        }
+        scope.reset();
+        TaskPool::getInstance().notify();
+    });
+    return Object(future);
+}
+
+Object Interpreter::visitAwaitExpr(Await& expr) {
+    Object future = evaluate(expr.m_Future.get());
+    if (!future.isFuture()) {
+        throw RuntimeError(expr.m_Keyword, "Can only await futures.");
+    }
+    return future.getFuture()->await();
+}
+
 void Interpreter::visitExpressionStmt(Expression& stmt) {
     evaluate(stmt.m_Expression.get());
 }
@@ -423,9 +790,14 @@ void Interpreter::visitReturnStmt(Return& stmt) {
     // If the return statement is not void, evaluate the expression.
     if (stmt.m_Value.has_value()) {
         value = evaluate(stmt.m_Value->get());
-}
+        // A tail call left the callee pending, to run in place of this function instead of returning to it.
+        if (completion == COMPLETION_TAIL_CALL) {
+            return;
+        }
+    }
 
-throw ReturnException(value);
+    returnValue = std::move(value);
+    completion = COMPLETION_RETURN;
 }
 
 void Interpreter::visitBreakStmt(Break& stmt) {
@@ -436,19 +808,26 @@ void Interpreter::visitLetStmt(Let& stmt) {
     // maybe check if already contains key with stmt.m_Name.lexeme, if yes throw RuntimeError
 
     Object value;
+    if (stmt.m_NonEscaping) {
+        environment->clear(stmt.m_Slot);
+    }
     // If the variable has an initializer, evaluate the initializer.
     if (stmt.m_Initializer.has_value()) {
         value = evaluate(stmt.m_Initializer->get());
     }
 
     // Define the variable in the current environment with the given identifier and value
-    environment->define(stmt.m_Name.lexeme, value);
+    budget.charge(sizeof(Object));
+    define(stmt.m_Slot, stmt.m_GlobalIndex, stmt.m_IsCaptured, value);
 }
 
 void Interpreter::visitWhileStmt(While& stmt) {
     try {
         while (isTruthy(evaluate(stmt.m_Condition.get()))) {
             execute(stmt.m_Body.get());
+            if (completion != COMPLETION_NORMAL) {
+                return;
+            }
         }
     } catch (BreakException& e) {
         // catching break carefully and exiting loop
@@ -468,27 +847,51 @@ void Interpreter::visitIfStmt(If& stmt) {
 }
 
 void Interpreter::visitBlockStmt(Block& stmt) {
-    executeBlock(stmt.m_Statements, std::make_shared<Environment>(environment));
+    // The block's locals have slots in the current frame (see Resolver), so it runs in the current environment.
+    for (auto& statement : stmt.m_Statements) {
+        execute(statement.get());
+        if (completion != COMPLETION_NORMAL) {
+            return;
+        }
+    }
 }
 
 void Interpreter::visitFunctionStmt(Function& stmt) {
-    SharedCallablePtr function = std::make_shared<KarolaScriptFunction>(&stmt, environment, false);
+    // A local function that calls itself captures its own cell, so the cell has to exist before the function does.
+    if (stmt.m_IsCaptured) {
+        environment->defineCell(stmt.m_Slot, Object::Null());
+    }
+
+    budget.charge(sizeof(KarolaScriptFunction));
+    SharedCallablePtr function = std::make_shared<KarolaScriptFunction>(&stmt, captureUpvalues(stmt.m_Upvalues), false);
     Object functionObject(function);
-    environment->define(stmt.m_Name.lexeme, functionObject);
+    if (stmt.m_IsCaptured) {
+        *environment->cell(stmt.m_Slot) = functionObject;
+    } else {
+        define(stmt.m_Slot, stmt.m_GlobalIndex, false, functionObject);
+    }
+}
+
+namespace {
+    // Keeps lines printed by different threads (see TaskPool) from interleaving.
+    std::mutex outputMutex;
 }
 
 void Interpreter::visitPrintStmt(Print& printStmt) {
     if (!printStmt.m_Expression.has_value()){
+        std::lock_guard<std::mutex> lock(outputMutex);
         std::cout << "\n";
         return;
     }
 
     Object value = evaluate(printStmt.m_Expression->get());
-    std::cout << stringify(value) << std::endl;
+    std::string text = stringify(value);
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cout << text << std::endl;
 }
 
 void Interpreter::visitClazzStmt(Class& clazzStmt) {
-    environment->define(clazzStmt.m_Name.lexeme, Object::Null());
+    define(clazzStmt.m_Slot, clazzStmt.m_GlobalIndex, clazzStmt.m_IsCaptured, Object::Null());
 
     Object superclass = Object::Null();
     if (clazzStmt.m_Superclass.has_value()) {
@@ -501,32 +904,45 @@ void Interpreter::visitClazzStmt(Class& clazzStmt) {
     std::optional<SharedCallablePtr> superclassPtr = std::nullopt;
     if (clazzStmt.m_Superclass.has_value()) {
         superclassPtr = superclass.getCallable();
-        // create a new environment that binds "super" to the superclass
-        environment = std::make_shared<Environment>(environment);
-        environment->define("super", superclass);
+        // Bind "super" to the superclass for the methods to capture.
+        environment->define(clazzStmt.m_SuperSlot, superclass);
     }
 
     std::unordered_map<std::string, Object> methods;
     for (const auto& method : clazzStmt.m_Methods) {
         bool is_init = method->m_Name.lexeme == "init";
-        SharedCallablePtr callable = std::make_shared<KarolaScriptFunction>(method.get(), environment, is_init);
+        SharedCallablePtr callable = std::make_shared<KarolaScriptFunction>(method.get(), captureUpvalues(method->m_Upvalues), is_init);
         Object functionObject(callable);
         methods[method->m_Name.lexeme] = functionObject;
     }
 
     std::unordered_map<std::string, Object> staticMethods;
     for (const auto& staticMethod : clazzStmt.m_StaticMethods) {
-        SharedCallablePtr callable = std::make_shared<KarolaScriptFunction>(staticMethod.get(), environment, false);
+        SharedCallablePtr callable = std::make_shared<KarolaScriptFunction>(staticMethod.get(), captureUpvalues(staticMethod->m_Upvalues), false);
         Object staticFunctionObject(callable);
         staticMethods[staticMethod->m_Name.lexeme] = staticFunctionObject;
     }
 
-    if (!superclass.isNull()) {
-        //pop latest environment
-        environment = environment->m_Enclosing;
-    }
-
     SharedCallablePtr klass(KarolaScriptMetaClass::createClass(clazzStmt.m_Name.lexeme, superclassPtr, methods, staticMethods));
+
+    // The superclass is known now, so resolve every `super.method` in the class up front (unless other threads may be
+    // reading those caches).
+    if (superclassPtr.has_value() && !concurrency::active()) {
+        auto* superclassClass = static_cast<KarolaScriptClass*>(superclassPtr.value().get());
+        for (Super* superExpr : clazzStmt.m_SuperExprs) {
+            const Object* method = superclassClass->findMethod(superExpr->m_MethodId);
+            if (method != nullptr) {
+                superExpr->m_CachedClassId = superclassClass->m_Id;
+                superExpr->m_CachedMethod = static_cast<KarolaScriptFunction*>(method->getCallable().get());
+            }
+        }
+    }
     Object classObject(klass);
-    environment->assign(clazzStmt.m_Name, classObject);
+    if (clazzStmt.m_GlobalIndex != -1) {
+        globalTable.assign(clazzStmt.m_GlobalIndex, clazzStmt.m_Name, classObject);
+    } else if (clazzStmt.m_IsCaptured) {
+        *environment->cell(clazzStmt.m_Slot) = classObject;
+    } else {
+        environment->define(clazzStmt.m_Slot, classObject);
+    }
 }
\ No newline at end of file
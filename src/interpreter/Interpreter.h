@@ -5,17 +5,40 @@
 #include <cmath>
 
 #include "Environment.h"
+#include "ExecutionBudget.h"
+#include "GlobalTable.h"
 #include "../parser/Expr.h"
 #include "../parser/Stmt.h"
 #include "../util/Object.h"
 #include "../util/common.h"
 
+class KarolaScriptClass;
+class KarolaScriptFunction;
+
 class Interpreter : public StmtVisitor, public ExprVisitor<Object> {
 private:
+    // Environment of top-level code. Global variables themselves live in `globalTable`.
     std::shared_ptr<Environment> globals;
+    GlobalTable globalTable;
     std::shared_ptr<Environment> environment;
-    // Contains the number of "hops" between the current environment and the environment where the variable referenced by Expr* is stored
-    std::unordered_map<const Expr*, int> localsDistances;
+
+    ExecutionBudget budget;
+
+    /* How the statement that ran last completed. `return` doesn't throw: it sets the completion, and every statement
+     * running others (a block, a loop) stops as soon as it isn't COMPLETION_NORMAL, up to the function body, which
+     * takes the value with takeReturnValue(). A call in tail position (`return f(...)`) leaves the callee and its frame
+     * pending instead of running it, and runFrame() runs it once the caller is gone, so tail-recursive code runs in
+     * constant native stack and keeps only one Environment alive.
+     * */
+    enum Completion {
+        COMPLETION_NORMAL,
+        COMPLETION_RETURN,
+        COMPLETION_TAIL_CALL
+    };
+    Completion completion = COMPLETION_NORMAL;
+    Object returnValue;
+    SharedCallablePtr tailCallee;
+    std::shared_ptr<Environment> tailFrame;
 
     // The EnvironmentGuard class is used to manage the interpreter's environment stack. It follows the
     // RAII technique, which means that when an instance of the class is created, a copy of the current
@@ -41,6 +64,16 @@ private:
 public:
     Interpreter();
 
+    // An interpreter for running script code on another thread (see TaskPool). It starts out with a copy of `parent`'s
+    // globals, shares its budget (see ExecutionBudget::share()) and shares no environment with it.
+    explicit Interpreter(const Interpreter& parent);
+
+    void setLimits(const ExecutionLimits& limits);
+
+    ExecutionBudget& getBudget() { return budget; }
+
+    GlobalTable& getGlobals() { return globalTable; }
+
     /* This function unpacks every UniqueStmtPtr into a raw pointer and then executes it. This is because the Interpreter does not
      * own the dynamically allocated statement objects, it only operates on them, so it should use raw pointers instead of a
      * smart pointer to signal that it does not own and has no influence over the lifetime of the objects.
@@ -61,6 +94,8 @@ public:
     Object visitUnaryExpr(Unary& expr) override;
     Object visitVariableExpr(Variable& expr) override;
     Object visitTernaryExpr(Ternary& expr) override;
+    Object visitSpawnExpr(Spawn& expr) override;
+    Object visitAwaitExpr(Await& expr) override;
 
     void visitExpressionStmt(Expression& stmt) override;
     void visitReturnStmt(Return& stmt) override;
@@ -74,7 +109,7 @@ public:
     void visitClazzStmt(Class& clazzStmt) override;
 
 public:
-    void resolve(Expr* expr, int depth);
+    Environment& currentEnvironment() { return *environment; }
 
     Object evaluate(Expr* expr);
 
@@ -82,6 +117,32 @@ public:
 
     void executeBlock(const std::vector<UniqueStmtPtr>& statements, std::shared_ptr<Environment> enclosing_env);
 
+    // Runs `callee` in a frame from its newFrame(), performing any tail call it ends with from the current native frame.
+    Object runFrame(KarolaScriptCallable& callee, std::shared_ptr<Environment> frame);
+
+    // Keeps performing the pending tail call (and any tail call it makes in turn) from the current native frame.
+    Object runTailCalls();
+
+    // What the function body that just ran returned (null if it ran to its end), which ends the return. A tail call
+    // it ended with is left pending for runFrame().
+    Object takeReturnValue() {
+        if (completion != COMPLETION_RETURN) {
+            return Object::Null();
+        }
+        completion = COMPLETION_NORMAL;
+        return std::move(returnValue);
+    }
+
+    // Every Environment the interpreter creates goes through here so it can be charged against the memory budget.
+    std::shared_ptr<Environment> newEnvironment(size_t frameSize);
+
+    // `super.method(...)`: calls the superclass method with "this" bound, without creating a bound copy of it first.
+    Object callSuperMethod(Call& callExpr);
+
+    // `object.method(...)`: calls a method found on an instance with "this" bound to it, likewise without the bound
+    // copy. Anything else the property turns out to be is called like any other callee.
+    Object callMethod(Call& callExpr);
+
     // KarolaScript follows Ruby’s simple rule: `false` and `null` are falsey, and everything else is truthy
     bool isTruthy(const Object& object) const;
 
@@ -93,7 +154,39 @@ public:
 
     std::string stringify(const Object& object);
 
-    Object lookupVariable(const Token& identifier, const Expr* variableExpr);
-
     void loadNativeFunctions();
+
+private:
+    // Defines a declared name in the current environment (in a new cell if it's captured), or in the global table for a
+    // top-level declaration.
+    void define(int slot, int globalIndex, bool captured, const Object& value);
+
+    // The cells a function being created in the current environment captures.
+    std::vector<SharedCellPtr> captureUpvalues(const std::vector<UpvalueSource>& sources);
+
+    // The entry `callExpr` caches for `callable`, or null if the arity doesn't match.
+    static CallEntry selectCallEntry(KarolaScriptCallable& callable, const Call& callExpr);
+
+    // Call entries: callInFrame() for callables with frames, call() with the evaluated arguments for the rest, and
+    // construction into the call site's recycled instance (see Call::m_NonEscaping).
+    template<typename Callee>
+    static Object callInFrameEntry(Interpreter& interpreter, const SharedCallablePtr& callee, Call& callExpr);
+    static Object callWithArguments(Interpreter& interpreter, const SharedCallablePtr& callee, Call& callExpr);
+    static Object constructRecycled(Interpreter& interpreter, const SharedCallablePtr& callee, Call& callExpr);
+
+    // Evaluates the call's arguments into the parameter slots of a new frame of `callable` and runs it. Instantiated
+    // for each concrete callable type, so newFrame() and run() are direct calls.
+    template<typename Callee>
+    Object callInFrame(Callee& callable, const SharedCallablePtr& callee, Call& callExpr);
+
+    // Calls an evaluated callee through the call site's cache.
+    Object callValue(Call& callExpr, const Object& callee);
+
+    // The property `expr` names on an already evaluated object, and the method it names on an instance's class, cached
+    // on the Get by class id.
+    Object getProperty(Get& expr, const Object& object);
+    KarolaScriptFunction* findMethod(Get& expr, KarolaScriptClass& klass);
+
+    KarolaScriptFunction* findSuperMethod(Super& expr);
+    SharedInstancePtr superReceiver(const Super& expr);
 };
@@ -13,29 +13,39 @@
 #include "RuntimeError.h"
 
 KarolaScriptAnonFunction::KarolaScriptAnonFunction(const AnonFunction* declaration_,
-                                           std::shared_ptr<Environment> closure_
+                                           std::vector<SharedCellPtr> upvalues_
                                            )
-        : KarolaScriptCallable(CallableType::ANON_FUNCTION), m_Declaration(declaration_), m_Closure(std::move(closure_)) {}
+        : KarolaScriptCallable(CallableType::ANON_FUNCTION), m_Declaration(declaration_), m_Upvalues(std::move(upvalues_)) {}
 
-Object KarolaScriptAnonFunction::call(Interpreter& interpreter, const std::vector<Object>& arguments) {
-    std::shared_ptr<Environment> environment = std::make_shared<Environment>(m_Closure);
-
-    if (!arguments.empty()) {
-        for (int i = 0; i < m_Declaration->m_Params.size(); i++) { // m_Declaration->m_Params.size() == arguments.size() => HAS TO BE!!!
-            environment->define(m_Declaration->m_Params[i], arguments[i]);
-        }
+Object KarolaScriptAnonFunction::call(Interpreter& interpreter, Arguments arguments) {
+    int firstParameter;
+    std::shared_ptr<Environment> frame = newFrame(interpreter, firstParameter);
+    for (size_t i = 0; i < arguments.size(); i++) {
+        frame->m_Slots[i] = arguments[i];
     }
+    return interpreter.runFrame(*this, std::move(frame));
+}
+
+std::shared_ptr<Environment> KarolaScriptAnonFunction::newFrame(Interpreter& interpreter, int& firstParameter) {
+    std::shared_ptr<Environment> frame = interpreter.newEnvironment(m_Declaration->m_FrameSize);
+    frame->m_Upvalues = &m_Upvalues;
+    firstParameter = 0;
+    return frame;
+}
 
-    try {
-        interpreter.executeBlock(m_Declaration->m_Body, environment);
-    } catch (ReturnException& returnValue) {
-        /* NOTE: This exception was thrown in the visitReturnStmt method of the interpreter */
-        return returnValue.m_Value;
+Object KarolaScriptAnonFunction::run(Interpreter& interpreter, std::shared_ptr<Environment> frame) {
+    for (int slot : m_Declaration->m_CapturedParams) {
+        frame->defineCell(slot, frame->get(slot));
     }
 
-    return Object::Null();
+    interpreter.executeBlock(m_Declaration->m_Body, std::move(frame));
+    return interpreter.takeReturnValue();
 }
 
 int KarolaScriptAnonFunction::arity() {
     return m_Declaration->m_Params.size();
+}
+
+std::string KarolaScriptAnonFunction::sharedWrite() {
+    return m_Declaration->m_SharedWrite;
 }
\ No newline at end of file
@@ -10,16 +10,20 @@
 class AnonFunction;
 class Interpreter;
 
-class KarolaScriptAnonFunction : public KarolaScriptCallable {
+class KarolaScriptAnonFunction final : public KarolaScriptCallable {
 public:
     //non owning. All AST nodes are owned by runner.cpp
     const AnonFunction* m_Declaration;
-    std::shared_ptr<Environment> m_Closure;
+    // Cells of the variables it captures, in the order of m_Declaration->m_Upvalues.
+    std::vector<SharedCellPtr> m_Upvalues;
 public:
-    KarolaScriptAnonFunction(const AnonFunction* declaration_, std::shared_ptr<Environment> closure_);
+    KarolaScriptAnonFunction(const AnonFunction* declaration_, std::vector<SharedCellPtr> upvalues_);
 
-    Object call(Interpreter& interpreter, const std::vector<Object>& arguments) override;
+    Object call(Interpreter& interpreter, Arguments arguments) override;
+    std::shared_ptr<Environment> newFrame(Interpreter& interpreter, int& firstParameter) override;
+    Object run(Interpreter& interpreter, std::shared_ptr<Environment> frame) override;
     int arity() override;
     std::string toString() override {return "";}
     std::string name() override {return "";}
+    std::string sharedWrite() override;
 };
\ No newline at end of file
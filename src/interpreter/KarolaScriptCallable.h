@@ -1,16 +1,48 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <memory>
 #include <string>
 
-class Object;
+#include "../util/Object.h"
+#include "../util/common.h"
+
+class Environment;
 class Interpreter;
 
+/* The arguments of a call to a native or a class: a view of values the caller owns, valid for the duration of the call.
+ * A callable that needs them afterwards copies them.
+ * */
+class Arguments {
+private:
+    const Object* m_Data = nullptr;
+    size_t m_Size = 0;
+public:
+    Arguments() = default;
+
+    Arguments(const Object* data, size_t size) : m_Data(data), m_Size(size) {}
+
+    Arguments(const std::vector<Object>& values) : m_Data(values.data()), m_Size(values.size()) {}
+
+    size_t size() const { return m_Size; }
+
+    bool empty() const { return m_Size == 0; }
+
+    const Object& operator[](size_t index) const { return m_Data[index]; }
+
+    const Object* begin() const { return m_Data; }
+
+    const Object* end() const { return m_Data + m_Size; }
+};
+
 class KarolaScriptCallable {
 public:
+    /* Which class the callable is, so hot paths can static_cast to it instead of using RTTI: FUNCTION is always a
+     * KarolaScriptFunction, ANON_FUNCTION a KarolaScriptAnonFunction, CLASS a KarolaScriptClass and NATIVE one of the
+     * stdlib functions. */
     enum CallableType {
-        FUNCTION, CLASS, ANON_FUNCTION
+        FUNCTION, CLASS, ANON_FUNCTION, NATIVE
     };
 
     CallableType m_Type;
@@ -18,8 +50,22 @@ public:
     explicit KarolaScriptCallable(CallableType type) : m_Type(type) {};
     virtual ~KarolaScriptCallable() = default;  // for derived class
 
-    virtual Object call(Interpreter& interpreter, const std::vector<Object>& arguments) = 0;
+    virtual Object call(Interpreter& interpreter, Arguments arguments) = 0;
     virtual int arity() = 0;
     virtual std::string toString() = 0;
     virtual std::string name() = 0;
-};
\ No newline at end of file
+    // What calling a native does. Script functions are analyzed from their declaration instead.
+    virtual Effect effect() { return EFFECT_EFFECTFUL; }
+    // The first thing calling it does that writes state other code can see (see EffectAnalyzer), empty if it writes
+    // none. Natives write nothing scripts can see.
+    virtual std::string sharedWrite() { return ""; }
+
+    /* Callables that run script code do it in a frame of their own, and a call site evaluates the arguments straight
+     * into the frame's parameter slots, starting at `firstParameter`, instead of collecting them first. Null for
+     * callables that only take Arguments. */
+    virtual std::shared_ptr<Environment> newFrame(Interpreter&, int& /*firstParameter*/) { return nullptr; }
+
+    // Runs the callable in a frame from newFrame() with the parameters filled in. Leaves a tail call it ends with
+    // pending, for the trampoline (Interpreter::runTailCalls) to perform.
+    virtual Object run(Interpreter&, std::shared_ptr<Environment>) { return Object(); }
+};
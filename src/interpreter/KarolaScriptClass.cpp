@@ -4,17 +4,32 @@
 #include <utility>
 #include <sstream>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 
 #include "RuntimeError.h"
 #include "../util/Object.h"
 #include "../lexer/Token.h"
+#include "../parser/Expr.h"
+#include "../parser/Stmt.h"
 #include "KarolaScriptFunction.h"
+#include "Interpreter.h"
+#include "../util/Concurrency.h"
+
+static uint32_t nextClassId() {
+    // 0 is never handed out, so it can mean "no class" in a cache.
+    static std::atomic<uint32_t> lastId{0};
+    return ++lastId;
+}
 
 KarolaScriptClass::KarolaScriptClass(const std::string& name_,
                                     const std::optional<SharedCallablePtr> superclass_,
                                     const std::unordered_map<std::string, Object>& methods_,
                                     const std::unordered_map<std::string, Object>& staticMethods_
-                                    ) : KarolaScriptCallable(CallableType::CLASS), m_ClassName(name_), m_Superclass(superclass_), m_Methods(methods_), m_StaticMethods(staticMethods_)
+                                    ) : KarolaScriptCallable(CallableType::CLASS), m_ClassName(name_), m_Superclass(superclass_), m_Methods(methods_), m_StaticMethods(staticMethods_), m_Id(nextClassId())
 {
     if (name_ != "MetaClazz" && name_ != "Math") {
         if (m_Superclass.has_value() && m_Superclass->get()->m_Type != CallableType::CLASS)
@@ -22,37 +37,123 @@ KarolaScriptClass::KarolaScriptClass(const std::string& name_,
 
         metaClass = &KarolaScriptMetaClass::getInstance();
     }
+    buildMethodTable();
+    resolveInitializer();
+}
+
+void KarolaScriptClass::buildMethodTable() {
+    if (m_Superclass.has_value() && m_Superclass.value() != nullptr) {
+        m_MethodTable = static_cast<KarolaScriptClass*>(m_Superclass.value().get())->m_MethodTable;
+    }
+
+    for (const auto& [methodName, method] : m_Methods) {
+        SymbolId id = symbols::intern(methodName);
+        if (id >= m_MethodTable.size()) {
+            m_MethodTable.resize(id + 1);
+        }
+        m_MethodTable[id] = method;
+    }
 }
 
-Object KarolaScriptClass::call(Interpreter& interpreter, const std::vector<Object>& arguments) {
+void KarolaScriptClass::redefine(std::optional<SharedCallablePtr> superclass,
+                                 std::unordered_map<std::string, Object> methods,
+                                 std::unordered_map<std::string, Object> staticMethods) {
+    m_Superclass = std::move(superclass);
+    m_Methods = std::move(methods);
+    m_StaticMethods = std::move(staticMethods);
+
+    m_MethodTable.clear();
+    buildMethodTable();
+    m_Initializer = nullptr;
+    m_Arity = 0;
+    m_FieldShape.clear();
+    resolveInitializer();
+}
+
+// Collects the names of the fields a statement assigns with `this.name = ...`, in the order they first appear.
+static void collectFieldShape(const Stmt* stmt, std::vector<std::string>& fields) {
+    if (auto block = dynamic_cast<const Block*>(stmt)) {
+        for (const auto& statement : block->m_Statements) {
+            collectFieldShape(statement.get(), fields);
+        }
+        return;
+    }
+
+    auto expression = dynamic_cast<const Expression*>(stmt);
+    if (expression == nullptr) {
+        return;
+    }
+    auto set = dynamic_cast<const Set*>(expression->m_Expression.get());
+    if (set == nullptr || dynamic_cast<const This*>(set->m_Object.get()) == nullptr) {
+        return;
+    }
+    if (std::find(fields.begin(), fields.end(), set->m_Name.lexeme) == fields.end()) {
+        fields.push_back(set->m_Name.lexeme);
+    }
+}
+
+void KarolaScriptClass::resolveInitializer() {
+    const Object* initializer = findMethod(symbols::intern("init"));
+    if (initializer == nullptr) {
+        return;
+    }
+
+    m_Initializer = static_cast<KarolaScriptFunction*>(initializer->getCallable().get());
+    m_Arity = m_Initializer->arity();
+    for (const auto& statement : m_Initializer->m_Declaration->m_Body) {
+        collectFieldShape(statement.get(), m_FieldShape);
+    }
+}
+
+Object KarolaScriptClass::call(Interpreter& interpreter, Arguments arguments) {
+    interpreter.getBudget().charge(sizeof(KarolaScriptInstance));
     SharedInstancePtr instance = std::make_shared<KarolaScriptInstance>(shared_from_this());
-    std::optional<Object> initializer = findMethod("init");
-    if (initializer.has_value()) {
-    //            initializer->bind(instance)->call(interpreter, arguments);
-        KarolaScriptFunction* function = dynamic_cast<KarolaScriptFunction*>(initializer.value().getCallable().get());
+    if (m_Initializer != nullptr) {
+        // Run the constructor with "this" bound, without creating a bound copy of it.
+        m_Initializer->callBound(interpreter, arguments, instance);
+    }
+    return Object(std::move(instance));
+}
 
-        //Create a new version of the constructor with "this" bound
-        KarolaScriptFunction* newFunction = function->bind(instance);
-        //call the constructor
-        newFunction->call(interpreter, arguments);
-        //Once we call the constructor we no longer need the newFunction so delete it before it leaks.
-        delete newFunction;
+std::shared_ptr<Environment> KarolaScriptClass::newFrame(Interpreter& interpreter, int& firstParameter) {
+    if (m_Initializer == nullptr) {
+        return nullptr;
     }
-    Object instanceObj(instance);
-    return instanceObj;
+    interpreter.getBudget().charge(sizeof(KarolaScriptInstance));
+    SharedInstancePtr instance = std::make_shared<KarolaScriptInstance>(shared_from_this());
+    return m_Initializer->newFrame(interpreter, instance, firstParameter);
 }
 
-std::optional<Object> KarolaScriptClass::findMethod(const std::string& name) {
-    if (m_Methods.find(name) != m_Methods.end()) {
-        return m_Methods[name];
+SharedInstancePtr KarolaScriptClass::newInstance(Interpreter& interpreter, SharedInstancePtr& recycled) {
+    if (recycled != nullptr && recycled.use_count() == 1 && recycled->getClass() == this) {
+        recycled->clearFields();
+        return recycled;
     }
+    interpreter.getBudget().charge(sizeof(KarolaScriptInstance));
+    recycled = std::make_shared<KarolaScriptInstance>(shared_from_this());
+    return recycled;
+}
+
+std::shared_ptr<Environment> KarolaScriptClass::newFrame(Interpreter& interpreter, SharedInstancePtr& recycled, int& firstParameter) {
+    return m_Initializer->newFrame(interpreter, newInstance(interpreter, recycled), firstParameter);
+}
+
+Object KarolaScriptClass::run(Interpreter& interpreter, std::shared_ptr<Environment> frame) {
+    return m_Initializer->run(interpreter, std::move(frame));
+}
 
-    if (m_Superclass.has_value()) {
-        auto* ksClass = dynamic_cast<KarolaScriptClass*>(m_Superclass.value().get());
-        return ksClass->findMethod(name);
+std::optional<Object> KarolaScriptClass::findMethod(const std::string& name) {
+    // A name that was never interned can't be the name of a method.
+    std::optional<SymbolId> id = symbols::find(name);
+    if (!id.has_value()) {
+        return std::nullopt;
     }
 
-    return std::nullopt;
+    const Object* method = findMethod(id.value());
+    if (method == nullptr) {
+        return std::nullopt;
+    }
+    return *method;
 }
 
 std::optional<Object> KarolaScriptClass::findStaticMethod(const std::string& name) {
@@ -67,10 +168,7 @@ Object KarolaScriptClass::getProperty(const Token& identifier) {
 }
 
 int KarolaScriptClass::arity() {
-    std::optional<Object> initializer = findMethod("init");
-    if (!initializer.has_value()) return 0;
-
-    return initializer->getCallable()->arity();
+    return m_Arity;
 }
 
 std::string KarolaScriptClass::toString() {
@@ -81,18 +179,62 @@ std::string KarolaScriptClass::name() {
     return m_ClassName;
 }
 
+std::string KarolaScriptClass::sharedWrite() {
+    return m_Initializer != nullptr ? m_Initializer->m_Declaration->m_SharedWrite : "";
+}
 
-KarolaScriptInstance::KarolaScriptInstance(std::shared_ptr<KarolaScriptClass> klass_) : m_Klass(std::move(klass_)) {}
 
-Object KarolaScriptInstance::getProperty(const Token& identifier) {
-    auto searched = m_Fields.find(identifier.lexeme);
+KarolaScriptInstance::KarolaScriptInstance(std::shared_ptr<KarolaScriptClass> klass_) : m_Klass(std::move(klass_)) {
+    m_Fields.reserve(m_Klass->fieldShape().size());
+}
+
+namespace {
+    constexpr size_t FIELD_LOCKS = 64;
+    std::mutex fieldLocks[FIELD_LOCKS];
+
+    // Holds the lock of an instance's fields while script code runs on more than one thread.
+    class FieldGuard {
+    private:
+        std::mutex* m_Mutex = nullptr;
+    public:
+        explicit FieldGuard(const KarolaScriptInstance* instance) {
+            if (concurrency::active()) {
+                m_Mutex = &fieldLocks[(reinterpret_cast<uintptr_t>(instance) / alignof(std::max_align_t)) % FIELD_LOCKS];
+                m_Mutex->lock();
+            }
+        }
+
+        ~FieldGuard() {
+            if (m_Mutex != nullptr) {
+                m_Mutex->unlock();
+            }
+        }
+
+        FieldGuard(const FieldGuard&) = delete;
+        FieldGuard& operator=(const FieldGuard&) = delete;
+    };
+}
+
+bool KarolaScriptInstance::findField(const std::string& name, Object& value) const {
+    FieldGuard guard(this);
+    auto searched = m_Fields.find(name);
     if (searched != m_Fields.end()) {
-        return searched->second;
+        value = searched->second;
+        return true;
+    }
+    return false;
+}
+
+Object KarolaScriptInstance::getProperty(const Token& identifier) {
+    Object field;
+    if (findField(identifier.lexeme, field)) {
+        return field;
     }
 
     std::optional<Object> method = m_Klass->findMethod(identifier.lexeme);
     if (method.has_value()) {
-        KarolaScriptFunction *function = dynamic_cast<KarolaScriptFunction*>(method.value().getCallable().get());
+        // Method tables only ever hold script functions.
+        KarolaScriptFunction *function = static_cast<KarolaScriptFunction*>(method.value().getCallable().get());
         //Create a new function where the variable "this" is binded to this instance
         SharedCallablePtr newFunction(function->bind(shared_from_this()));
         Object newFunctionObject(newFunction);
@@ -103,9 +245,17 @@ Object KarolaScriptInstance::getProperty(const Token& identifier) {
 }
 
 void KarolaScriptInstance::setProperty(const Token& identifier, const Object& value) {
+    FieldGuard guard(this);
     m_Fields[identifier.lexeme] = value;
 }
 
+SharedInstancePtr KarolaScriptInstance::copy(std::shared_ptr<KarolaScriptClass> klass) const {
+    auto instance = std::make_shared<KarolaScriptInstance>(std::move(klass));
+    FieldGuard guard(this);
+    instance->m_Fields = m_Fields;
+    return instance;
+}
+
 std::string KarolaScriptInstance::toString() {
     std::stringstream ss;
     ss << "<Instance of class " << m_Klass->name() << " at " << this << ">";
@@ -8,8 +8,10 @@
 
 #include "KarolaScriptCallable.h"
 #include "../util/Object.h"
+#include "../util/Symbols.h"
 
 class Interpreter;
+class KarolaScriptFunction;
 struct Token;
 
 class KarolaScriptMetaClass;
@@ -21,6 +23,24 @@ public:
     std::unordered_map<std::string, Object> m_Methods;
     std::unordered_map<std::string, Object> m_StaticMethods;
     KarolaScriptMetaClass* metaClass;
+
+    // Unique per class object, so a cache can remember which class it was filled for without keeping it alive.
+    const uint32_t m_Id;
+private:
+    /* Every method the class responds to, its own and inherited ones, indexed by the SymbolId of the method name. Built
+     * once when the class is created: the superclass' (already flattened) table is copied and the class' own methods
+     * are written over it, so looking a method up never has to walk the hierarchy. Slots for names that aren't methods
+     * of the class hold null.
+     * */
+    std::vector<Object> m_MethodTable;
+
+    /* Constructor metadata, resolved once when the class is created instead of on every instantiation: the `init`
+     * method (own or inherited, nullptr if there is none), its arity and the names of the fields `init` assigns to
+     * `this`, which every new instance reserves room for up front.
+     * */
+    KarolaScriptFunction* m_Initializer = nullptr;
+    int m_Arity = 0;
+    std::vector<std::string> m_FieldShape;
 public:
     KarolaScriptClass(const std::string& name_,
                       const std::optional<SharedCallablePtr> superclass_,
@@ -28,13 +48,45 @@ public:
                       const std::unordered_map<std::string, Object>& staticMethods_
                       );
 
-    Object call(Interpreter& interpreter, const std::vector<Object>& arguments) override;
+    Object call(Interpreter& interpreter, Arguments arguments) override;
+    // With an initializer, the new instance is created along with the initializer's frame, and running the frame
+    // returns it.
+    std::shared_ptr<Environment> newFrame(Interpreter& interpreter, int& firstParameter) final;
+    Object run(Interpreter& interpreter, std::shared_ptr<Environment> frame) final;
+    /* A new instance for a call site that recycles its instances: `recycled` itself, with its fields dropped, when it's
+     * an instance of this class and nothing but `recycled` references it anymore, otherwise a newly allocated one,
+     * which then replaces it.
+     * */
+    SharedInstancePtr newInstance(Interpreter& interpreter, SharedInstancePtr& recycled);
+    // newFrame() with the instance from newInstance().
+    std::shared_ptr<Environment> newFrame(Interpreter& interpreter, SharedInstancePtr& recycled, int& firstParameter);
+    bool hasInitializer() const { return m_Initializer != nullptr; }
     std::optional<Object> findMethod(const std::string& name);
+    // Returns the method or nullptr.
+    const Object* findMethod(SymbolId name) const {
+        if (name < m_MethodTable.size() && m_MethodTable[name].type != OBJTYPE_NULL) {
+            return &m_MethodTable[name];
+        }
+        return nullptr;
+    }
     std::optional<Object> findStaticMethod(const std::string& name);
     Object getProperty(const Token& identifier);
     int arity() override;
     std::string toString() override;
     std::string name() override;
+    // What its initializer writes besides the new instance.
+    std::string sharedWrite() override;
+
+    const std::vector<std::string>& fieldShape() const { return m_FieldShape; }
+
+    // Replaces the superclass and the class' own methods, and everything resolved from them. Only for a class no code
+    // has used yet (see MessageCopier).
+    void redefine(std::optional<SharedCallablePtr> superclass, std::unordered_map<std::string, Object> methods,
+                  std::unordered_map<std::string, Object> staticMethods);
+
+private:
+    void buildMethodTable();
+    void resolveInitializer();
 };
 
 class KarolaScriptMetaClass : public KarolaScriptClass {
@@ -55,13 +107,26 @@ public:
     }
 };
 
+/* While script code runs on more than one thread (see Concurrency.h), reading or writing a field holds a lock, one of a
+ * fixed set picked by the instance's address, so a thread reading an instance that another one is writing sees each
+ * field either before or after a write.
+ * */
 class KarolaScriptInstance : public std::enable_shared_from_this<KarolaScriptInstance> {
 private:
     std::shared_ptr<KarolaScriptClass> m_Klass;
     std::unordered_map<std::string, Object> m_Fields;
 public:
     explicit KarolaScriptInstance(std::shared_ptr<KarolaScriptClass> klass_);
+    KarolaScriptClass* getClass() const { return m_Klass.get(); }
+    // Copies the field into `value`, false if there is none. Unlike getProperty() it doesn't look at methods.
+    bool findField(const std::string& name, Object& value) const;
+    void clearFields() { m_Fields.clear(); }
     Object getProperty(const Token& identifier);
     void setProperty(const Token& identifier, const Object& value);
     std::string toString();
+
+    // A new instance of `klass` with a copy of the fields.
+    SharedInstancePtr copy(std::shared_ptr<KarolaScriptClass> klass) const;
+    // The fields of an instance no other thread can reach.
+    std::unordered_map<std::string, Object>& fields() { return m_Fields; }
 };
\ No newline at end of file
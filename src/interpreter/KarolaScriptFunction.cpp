@@ -13,39 +13,81 @@
 #include "RuntimeError.h"
 
 KarolaScriptFunction::KarolaScriptFunction(const Function* declaration_,
-                                           std::shared_ptr<Environment> closure_,
-                                           bool isInitializer_
+                                           std::vector<SharedCellPtr> upvalues_,
+                                           bool isInitializer_,
+                                           SharedInstancePtr receiver_
                                                 )
-                    : KarolaScriptCallable(CallableType::FUNCTION), m_Declaration(declaration_), m_Closure(std::move(closure_)), m_IsInitializer_(isInitializer_) {}
+                    : KarolaScriptCallable(CallableType::FUNCTION), m_Declaration(declaration_), m_Upvalues(std::move(upvalues_)),
+                      m_Receiver(std::move(receiver_)), m_IsInitializer_(isInitializer_) {
+    if (m_Declaration->m_MemoCapacity != 0) {
+        m_Memo = std::make_unique<MemoCache>(m_Declaration->m_MemoCapacity);
+    }
+}
 
-Object KarolaScriptFunction::call(Interpreter& interpreter, const std::vector<Object>& arguments) {
-    std::shared_ptr<Environment> environment = std::make_shared<Environment>(m_Closure);
+Object KarolaScriptFunction::call(Interpreter& interpreter, Arguments arguments) {
+    return callBound(interpreter, arguments, m_Receiver);
+}
 
-    if (!arguments.empty()) {
-        for (int i = 0; i < m_Declaration->m_Params.size(); i++) { // m_Declaration->m_Params.size() == arguments.size() => HAS TO BE!!!
-            environment->define(m_Declaration->m_Params[i], arguments[i]);
-        }
+Object KarolaScriptFunction::callBound(Interpreter& interpreter, Arguments arguments, SharedInstancePtr instance) {
+    int firstParameter;
+    std::shared_ptr<Environment> frame = newFrame(interpreter, instance, firstParameter);
+    for (size_t i = 0; i < arguments.size(); i++) {
+        frame->m_Slots[firstParameter + i] = arguments[i];
     }
+    return interpreter.runFrame(*this, std::move(frame));
+}
+
+std::shared_ptr<Environment> KarolaScriptFunction::newFrame(Interpreter& interpreter, int& firstParameter) {
+    return newFrame(interpreter, m_Receiver, firstParameter);
+}
 
-    try {
-        interpreter.executeBlock(m_Declaration->m_Body, environment);
-    } catch (ReturnException& returnValue) {
-        /* NOTE: This exception was thrown in the visitReturnStmt method of the interpreter */
+std::shared_ptr<Environment> KarolaScriptFunction::newFrame(Interpreter& interpreter, const SharedInstancePtr& receiver, int& firstParameter) {
+    std::shared_ptr<Environment> frame = interpreter.newEnvironment(m_Declaration->m_FrameSize);
+    frame->m_Upvalues = &m_Upvalues;
 
-        // Initializer should always implicitly return "this".
-        if (m_IsInitializer_) {
-            return m_Closure->getAt(0, "this");
-        }
-        return returnValue.m_Value;
+    // A method's parameters come after "this" in slot 0.
+    firstParameter = 0;
+    if (receiver != nullptr) {
+        frame->m_Slots[0] = Object(receiver);
+        firstParameter = 1;
+    }
+    return frame;
+}
+
+Object KarolaScriptFunction::run(Interpreter& interpreter, std::shared_ptr<Environment> frame) {
+    if (m_Memo == nullptr) {
+        return runBody(interpreter, std::move(frame));
+    }
+
+    // Only functions are memoized, so the parameters start at slot 0.
+    MemoCache::Key key;
+    if (!MemoCache::makeKey(frame->m_Slots.data(), m_Declaration->m_Params.size(), key)) {
+        return runBody(interpreter, std::move(frame));
+    }
+    Object result;
+    if (m_Memo->find(key, result)) {
+        return result;
+    }
+    result = runBody(interpreter, std::move(frame));
+    m_Memo->insert(std::move(key), result);
+    return result;
+}
+
+Object KarolaScriptFunction::runBody(Interpreter& interpreter, std::shared_ptr<Environment> frame) {
+    for (int slot : m_Declaration->m_CapturedParams) {
+        frame->defineCell(slot, frame->get(slot));
     }
 
     if (m_IsInitializer_) {
-        // Initializer should always implicitly return "this". This line covers the case where the initializer has no return stmt
-        // but we still need to return "this".
-        return m_Closure->getAt(0, "this");
+        // Initializer should always implicitly return "this", whether or not it has a return stmt.
+        Object instance = frame->get(0);
+        interpreter.executeBlock(m_Declaration->m_Body, std::move(frame));
+        interpreter.takeReturnValue();
+        return instance;
     }
 
-    return Object::Null();
+    interpreter.executeBlock(m_Declaration->m_Body, std::move(frame));
+    return interpreter.takeReturnValue();
 }
 
 int KarolaScriptFunction::arity() {
@@ -53,10 +95,7 @@ int KarolaScriptFunction::arity() {
 }
 
 KarolaScriptFunction* KarolaScriptFunction::bind(SharedInstancePtr instance) {
-    std::shared_ptr<Environment> environment = std::make_shared<Environment>(m_Closure);
-    Object instanceObj(std::move(instance));
-    environment->define("this", instanceObj);
-    return new KarolaScriptFunction(m_Declaration, environment, m_IsInitializer_);
+    return new KarolaScriptFunction(m_Declaration, m_Upvalues, m_IsInitializer_, std::move(instance));
 }
 
 std::string KarolaScriptFunction::toString() {
@@ -65,4 +104,12 @@ std::string KarolaScriptFunction::toString() {
 
 std::string KarolaScriptFunction::name() {
     return m_Declaration->m_Name.lexeme;
+}
+
+std::string KarolaScriptFunction::sharedWrite() {
+    // Setting fields of `this` only doesn't count for an initializer, but a bound one runs on an existing instance.
+    if (m_IsInitializer_) {
+        return "it re-initializes an existing instance";
+    }
+    return m_Declaration->m_SharedWrite;
 }
\ No newline at end of file
@@ -1,33 +1,53 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "Environment.h"
 #include "KarolaScriptCallable.h"
+#include "MemoCache.h"
 #include "../util/Object.h"
 
 class Function;
 class Interpreter;
 
-class KarolaScriptFunction : public KarolaScriptCallable {
+class KarolaScriptFunction final : public KarolaScriptCallable {
 public:
     //non owning. All AST nodes are owned by runner.cpp
     const Function* m_Declaration;
-    std::shared_ptr<Environment> m_Closure;
+    // Cells of the variables it captures, in the order of m_Declaration->m_Upvalues. Empty for a function that
+    // captures nothing, which then keeps no environment alive.
+    std::vector<SharedCellPtr> m_Upvalues;
+    // The instance "this" is bound to in a copy made by bind().
+    SharedInstancePtr m_Receiver;
     bool m_IsInitializer_;
+    // Results of a `@memo` function, null for any other.
+    std::unique_ptr<MemoCache> m_Memo;
 public:
-    KarolaScriptFunction(const Function* declaration_, std::shared_ptr<Environment> closure_, bool isInitializer_ = false);
+    KarolaScriptFunction(const Function* declaration_, std::vector<SharedCellPtr> upvalues_, bool isInitializer_ = false,
+                         SharedInstancePtr receiver_ = nullptr);
 
     // params should be passed and declared inside executeBlock() method, this shouldn't happen probably
     // funct scope(a) {
     //      var a = "local";
     // }
-    Object call(Interpreter& interpreter, const std::vector<Object>& arguments) override;
+    Object call(Interpreter& interpreter, Arguments arguments) override;
+    // Same as bind(instance)->call(...) without creating the bound copy of the function.
+    Object callBound(Interpreter& interpreter, Arguments arguments, SharedInstancePtr instance);
     int arity() override;
     std::string toString() override;
     std::string name() override;
+    std::string sharedWrite() override;
 
-    //Creates a NEW function that is a copy of the current function but with a different closure where "this" is binded to an instance;
+    std::shared_ptr<Environment> newFrame(Interpreter& interpreter, int& firstParameter) override;
+    // A frame with `receiver` as "this", which is null for anything but a method.
+    std::shared_ptr<Environment> newFrame(Interpreter& interpreter, const SharedInstancePtr& receiver, int& firstParameter);
+    Object run(Interpreter& interpreter, std::shared_ptr<Environment> frame) override;
+
+    //Creates a NEW function that is a copy of the current function but with "this" binded to an instance;
     KarolaScriptFunction* bind(SharedInstancePtr instance);
+
+private:
+    Object runBody(Interpreter& interpreter, std::shared_ptr<Environment> frame);
 };
\ No newline at end of file
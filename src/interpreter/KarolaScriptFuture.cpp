@@ -0,0 +1,31 @@
+#include "KarolaScriptFuture.h"
+
+#include <utility>
+
+#include "TaskPool.h"
+
+void KarolaScriptFuture::resolve(const Object& result) {
+    m_Result = result;
+    m_Done.store(true, std::memory_order_release);
+    TaskPool::getInstance().notify();
+}
+
+void KarolaScriptFuture::fail(std::exception_ptr error) {
+    m_Error = std::move(error);
+    m_Done.store(true, std::memory_order_release);
+    TaskPool::getInstance().notify();
+}
+
+Object KarolaScriptFuture::await() {
+    if (!m_Done.load(std::memory_order_acquire)) {
+        TaskPool::getInstance().runUntil([this] { return m_Done.load(std::memory_order_acquire); });
+    }
+    if (m_Error) {
+        std::rethrow_exception(m_Error);
+    }
+    return m_Result;
+}
+
+std::string KarolaScriptFuture::toString() const {
+    return "<future>";
+}
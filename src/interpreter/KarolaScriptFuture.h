@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <string>
+
+#include "../util/Object.h"
+
+/* The result of a task started with `spawn`, which `await` waits for. A thread awaiting a future whose task isn't done
+ * yet runs other tasks of the TaskPool in the meantime, so a task can await the tasks it spawns without holding up a
+ * worker. Awaiting a future again gives the same result, or raises the same error.
+ * */
+class KarolaScriptFuture {
+private:
+    // Set once the task is done, after m_Result or m_Error.
+    std::atomic<bool> m_Done{false};
+    Object m_Result;
+    std::exception_ptr m_Error;
+public:
+    void resolve(const Object& result);
+    void fail(std::exception_ptr error);
+
+    // The result of the task, once it's done. Raises the error the task failed with again.
+    Object await();
+
+    std::string toString() const;
+};
@@ -0,0 +1,85 @@
+#include "MemoCache.h"
+
+#include <cmath>
+#include <functional>
+
+bool MemoCache::KeyEqual::operator()(const Key& lhs, const Key& rhs) const {
+    if (lhs.arguments.size() != rhs.arguments.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.arguments.size(); i++) {
+        const Object& left = lhs.arguments[i];
+        const Object& right = rhs.arguments[i];
+        if (left.isNumber() && right.isNumber()) {
+            if (left.getNumber() != right.getNumber()) {
+                return false;
+            }
+            continue;
+        }
+        if (left.type != right.type) {
+            return false;
+        }
+        if ((left.isBoolean() && left.getBoolean() != right.getBoolean()) ||
+            (left.isString() && left.getString() != right.getString())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MemoCache::makeKey(const Object* arguments, size_t count, Key& key) {
+    size_t hash = count;
+    key.arguments.assign(arguments, arguments + count);
+    for (const Object& argument : key.arguments) {
+        size_t element;
+        if (argument.isNumber()) {
+            double number = argument.getNumber();
+            // NaN never equals itself, so a key holding it could never be found again.
+            if (std::isnan(number)) {
+                return false;
+            }
+            // -0 == 0, so they have to hash the same too.
+            element = std::hash<double>()(number == 0 ? 0.0 : number);
+        } else if (argument.isString()) {
+            element = argument.getString().hash();
+        } else if (argument.isBoolean()) {
+            element = argument.getBoolean() ? 1 : 2;
+        } else if (argument.isNull()) {
+            element = 3;
+        } else {
+            return false;
+        }
+        hash ^= element + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    key.hash = hash;
+    return true;
+}
+
+bool MemoCache::find(const Key& key, Object& result) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto found = m_Index.find(key);
+    if (found == m_Index.end()) {
+        return false;
+    }
+    m_Entries.splice(m_Entries.begin(), m_Entries, found->second);
+    result = found->second->second;
+    return true;
+}
+
+void MemoCache::insert(Key key, const Object& result) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    // A recursive call may have cached the same arguments in the meantime.
+    auto existing = m_Index.find(key);
+    if (existing != m_Index.end()) {
+        existing->second->second = result;
+        m_Entries.splice(m_Entries.begin(), m_Entries, existing->second);
+        return;
+    }
+
+    if (m_Entries.size() >= m_Capacity) {
+        m_Index.erase(m_Entries.back().first);
+        m_Entries.pop_back();
+    }
+    m_Entries.emplace_front(std::move(key), result);
+    m_Index.emplace(m_Entries.front().first, m_Entries.begin());
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../util/Object.h"
+
+/* Results of a `@memo` function, keyed by its arguments, holding at most `capacity` of them. When it's full, the
+ * result used least recently is evicted.
+ *
+ * Only calls whose arguments are all primitives (numbers, strings, booleans, null) can be cached: those compare by
+ * value, whereas an instance or a function passed in could change between two calls without the key changing.
+ *
+ * Calls running on different threads (see TaskPool) share the cache, so every access takes its lock.
+ * */
+class MemoCache {
+public:
+    struct Key {
+        std::vector<Object> arguments;
+        size_t hash = 0;
+    };
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return key.hash; }
+    };
+    struct KeyEqual {
+        bool operator()(const Key& lhs, const Key& rhs) const;
+    };
+
+    using Entry = std::pair<Key, Object>;
+
+    size_t m_Capacity;
+    // Most recently used first.
+    std::list<Entry> m_Entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash, KeyEqual> m_Index;
+    std::mutex m_Mutex;
+public:
+    explicit MemoCache(size_t capacity) : m_Capacity(capacity) {}
+
+    // Fills `key` with the `count` arguments starting at `arguments`. False if one of them isn't a primitive.
+    static bool makeKey(const Object* arguments, size_t count, Key& key);
+
+    // Copies the cached result for `key` into `result`, making it the most recently used one. False if there's none.
+    bool find(const Key& key, Object& result);
+
+    void insert(Key key, const Object& result);
+};
@@ -0,0 +1,138 @@
+#include "MessageCopier.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "Interpreter.h"
+#include "KarolaScriptAnonFunction.h"
+#include "KarolaScriptClass.h"
+#include "KarolaScriptFunction.h"
+
+MessageCopier::MessageCopier(Interpreter& interpreter) : m_Interpreter(interpreter) {}
+
+Object MessageCopier::copy(const Object& value) {
+    if (value.isInstance()) {
+        return Object(copyInstance(value.getClassInstance()));
+    }
+    if (!value.isCallable() && !value.isAnonFunction()) {
+        return value;
+    }
+
+    SharedCallablePtr callable = value.getCallable();
+    if (callable->m_Type == KarolaScriptCallable::FUNCTION) {
+        auto& function = static_cast<KarolaScriptFunction&>(*callable);
+        if (function.m_Upvalues.empty() && function.m_Receiver == nullptr) {
+            return value;
+        }
+        m_Interpreter.getBudget().charge(sizeof(KarolaScriptFunction));
+        SharedInstancePtr receiver = function.m_Receiver != nullptr ? copyInstance(function.m_Receiver) : nullptr;
+        return Object(std::make_shared<KarolaScriptFunction>(function.m_Declaration, copyCells(function.m_Upvalues),
+                                                             function.m_IsInitializer_, std::move(receiver)));
+    }
+    if (callable->m_Type == KarolaScriptCallable::ANON_FUNCTION) {
+        auto& function = static_cast<KarolaScriptAnonFunction&>(*callable);
+        if (function.m_Upvalues.empty()) {
+            return value;
+        }
+        m_Interpreter.getBudget().charge(sizeof(KarolaScriptAnonFunction));
+        return Object(std::make_shared<KarolaScriptAnonFunction>(function.m_Declaration, copyCells(function.m_Upvalues)));
+    }
+    if (callable->m_Type == KarolaScriptCallable::CLASS) {
+        return Object(copyClass(callable));
+    }
+    return value;
+}
+
+SharedInstancePtr MessageCopier::copyInstance(const SharedInstancePtr& instance) {
+    auto copied = m_Instances.find(instance.get());
+    if (copied != m_Instances.end()) {
+        return copied->second;
+    }
+
+    auto klass = std::static_pointer_cast<KarolaScriptClass>(copyClass(instance->getClass()->shared_from_this()));
+    // Copying the class may have copied the instance already, if one of its methods captures it.
+    copied = m_Instances.find(instance.get());
+    if (copied != m_Instances.end()) {
+        return copied->second;
+    }
+
+    m_Interpreter.getBudget().charge(sizeof(KarolaScriptInstance));
+    SharedInstancePtr copy = instance->copy(std::move(klass));
+    // Recorded before the fields are copied, so a field referring back to the instance gets the copy.
+    m_Instances.emplace(instance.get(), copy);
+    for (auto& field : copy->fields()) {
+        field.second = this->copy(field.second);
+    }
+    return copy;
+}
+
+SharedCallablePtr MessageCopier::copyClass(const SharedCallablePtr& klass) {
+    auto copied = m_Classes.find(klass.get());
+    if (copied != m_Classes.end()) {
+        return copied->second;
+    }
+    auto& original = static_cast<KarolaScriptClass&>(*klass);
+    if (!capturesVariables(original)) {
+        m_Classes.emplace(klass.get(), klass);
+        return klass;
+    }
+
+    m_Interpreter.getBudget().charge(sizeof(KarolaScriptClass));
+    auto copy = std::make_shared<KarolaScriptClass>(original.m_ClassName, original.m_Superclass, original.m_Methods,
+                                                    original.m_StaticMethods);
+    // Recorded before the methods are copied, so a method capturing the class gets the copy.
+    m_Classes.emplace(klass.get(), copy);
+
+    std::optional<SharedCallablePtr> superclass = original.m_Superclass;
+    if (superclass.has_value() && superclass.value() != nullptr) {
+        superclass = copyClass(superclass.value());
+    }
+    std::unordered_map<std::string, Object> methods = original.m_Methods;
+    for (auto& method : methods) {
+        method.second = this->copy(method.second);
+    }
+    std::unordered_map<std::string, Object> staticMethods = original.m_StaticMethods;
+    for (auto& method : staticMethods) {
+        method.second = this->copy(method.second);
+    }
+    copy->redefine(std::move(superclass), std::move(methods), std::move(staticMethods));
+    return copy;
+}
+
+bool MessageCopier::capturesVariables(const KarolaScriptClass& klass) {
+    for (const auto* methods : {&klass.m_Methods, &klass.m_StaticMethods}) {
+        for (const auto& method : *methods) {
+            // Native methods, like the ones of the built-in Math class, capture nothing.
+            const SharedCallablePtr& callable = method.second.getCallable();
+            if (callable->m_Type == KarolaScriptCallable::FUNCTION &&
+                !static_cast<KarolaScriptFunction&>(*callable).m_Upvalues.empty()) {
+                return true;
+            }
+        }
+    }
+    if (klass.m_Superclass.has_value() && klass.m_Superclass.value() != nullptr) {
+        return capturesVariables(static_cast<const KarolaScriptClass&>(*klass.m_Superclass.value()));
+    }
+    return false;
+}
+
+std::vector<SharedCellPtr> MessageCopier::copyCells(const std::vector<SharedCellPtr>& cells) {
+    std::vector<SharedCellPtr> copies;
+    copies.reserve(cells.size());
+    for (const SharedCellPtr& cell : cells) {
+        auto copied = m_Cells.find(cell.get());
+        if (copied != m_Cells.end()) {
+            copies.push_back(copied->second);
+            continue;
+        }
+        m_Interpreter.getBudget().charge(sizeof(Object));
+        auto copy = std::make_shared<Object>();
+        m_Cells.emplace(cell.get(), copy);
+        // The cell may hold a closure that captures it.
+        *copy = this->copy(*cell);
+        copies.push_back(std::move(copy));
+    }
+    return copies;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "Environment.h"
+#include "../util/Object.h"
+
+class Interpreter;
+class KarolaScriptCallable;
+class KarolaScriptClass;
+class KarolaScriptInstance;
+
+/* Copies what a spawned task can reach (its function, its arguments and the globals), so the task gets a snapshot of it
+ * and nothing it reads changes while it runs (see Interpreter::visitSpawnExpr).
+ *
+ * Instances are copied along with everything their fields reach, functions along with the variables they capture and
+ * the instance they're bound to, and classes whose methods capture variables along with their methods. Sharing
+ * survives the copy: two values referring to the same instance, class or captured variable still do afterwards, and so
+ * do cycles. Strings, numbers, natives and classes that capture nothing can't change, so they're shared as they are.
+ * */
+class MessageCopier {
+private:
+    Interpreter& m_Interpreter;
+    std::unordered_map<const KarolaScriptInstance*, SharedInstancePtr> m_Instances;
+    std::unordered_map<const KarolaScriptCallable*, SharedCallablePtr> m_Classes;
+    std::unordered_map<const Object*, SharedCellPtr> m_Cells;
+public:
+    // Copies are charged against `interpreter`'s memory budget.
+    explicit MessageCopier(Interpreter& interpreter);
+
+    Object copy(const Object& value);
+
+private:
+    SharedInstancePtr copyInstance(const SharedInstancePtr& instance);
+    SharedCallablePtr copyClass(const SharedCallablePtr& klass);
+    std::vector<SharedCellPtr> copyCells(const std::vector<SharedCellPtr>& cells);
+
+    // Whether any script method of the class or of its superclasses captures variables.
+    static bool capturesVariables(const KarolaScriptClass& klass);
+};
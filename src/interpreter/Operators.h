@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+#include "Interpreter.h"
+#include "RuntimeError.h"
+#include "../lexer/Token.h"
+#include "../util/Object.h"
+#include "../util/Utils.h"
+
+/* Semantics of the unary and binary operators.
+ *
+ * Interpreter::visitBinaryExpr/visitUnaryExpr switch on the operator and call into here, while the handlers installed
+ * by the ClosureCompiler instantiate the operator they need directly, so both paths share one definition of what every
+ * operator does and the compiled ones don't have to look at the operator at runtime.
+ * */
+namespace operators {
+
+template<TokenType Op>
+Object binary(Interpreter& interpreter, const Token& op, const Object& left, const Object& right) {
+    // Two int32s are compared and added, subtracted or multiplied without going through doubles, as long as the
+    // result is an int32 with the same value the double operation would produce. Division, overflow and results
+    // that would be -0 as a double fall through to the double path below.
+    if (left.isInteger() && right.isInteger()) {
+        int32_t a = left.getInteger();
+        int32_t b = right.getInteger();
+        if constexpr (Op == TOKEN_EQUAL_EQUAL) {
+            return Object(a == b);
+        } else if constexpr (Op == TOKEN_BANG_EQUAL) {
+            return Object(a != b);
+        } else if constexpr (Op == TOKEN_GREATER) {
+            return Object(a > b);
+        } else if constexpr (Op == TOKEN_GREATER_EQUAL) {
+            return Object(a >= b);
+        } else if constexpr (Op == TOKEN_LESS) {
+            return Object(a < b);
+        } else if constexpr (Op == TOKEN_LESS_EQUAL) {
+            return Object(a <= b);
+        } else if constexpr (Op == TOKEN_PLUS || Op == TOKEN_MINUS || Op == TOKEN_STAR) {
+            int64_t result;
+            if constexpr (Op == TOKEN_PLUS) {
+                result = static_cast<int64_t>(a) + b;
+            } else if constexpr (Op == TOKEN_MINUS) {
+                result = static_cast<int64_t>(a) - b;
+            } else {
+                result = static_cast<int64_t>(a) * b;
+            }
+            bool negativeZero = Op == TOKEN_STAR && result == 0 && (a < 0 || b < 0);
+            if (result >= INT32_MIN && result <= INT32_MAX && !negativeZero) {
+                return Object::Integer(static_cast<int32_t>(result));
+            }
+        }
+    }
+
+    if constexpr (Op == TOKEN_EQUAL_EQUAL) {
+        return Object(interpreter.isEqual(left, right));
+    } else if constexpr (Op == TOKEN_BANG_EQUAL) {
+        return Object(!interpreter.isEqual(left, right));
+    } else if constexpr (Op == TOKEN_PLUS) {
+        if (left.isNumber() && right.isNumber()) {
+            return Object(left.getNumber() + right.getNumber());
+        }
+
+        // Only the appended bytes are charged: concat() extends left's buffer in place when it can.
+        KarolaScriptString result;
+        if (left.isString() && right.isString()) {
+            result = KarolaScriptString::concat(left.getString(), right.getString().view());
+            interpreter.getBudget().charge(right.getString().size());
+        } else if (left.isNumber() && right.isString()) {
+            utils::NumberBuffer buffer;
+            result = KarolaScriptString::concat(KarolaScriptString(utils::formatNumber(left.getNumber(), buffer)), right.getString().view());
+            interpreter.getBudget().charge(result.size());
+        } else if (left.isString() && right.isNumber()) {
+            utils::NumberBuffer buffer;
+            std::string_view number = utils::formatNumber(right.getNumber(), buffer);
+            result = KarolaScriptString::concat(left.getString(), number);
+            interpreter.getBudget().charge(number.size());
+        } else {
+            throw RuntimeError(op, "Operands must be of type string or number.");
+        }
+        return Object(std::move(result));
+    } else {
+        interpreter.checkNumberOperands(op, left, right);
+
+        if constexpr (Op == TOKEN_MINUS) {
+            return Object(left.getNumber() - right.getNumber());
+        } else if constexpr (Op == TOKEN_SLASH) {
+            // Throw error if right operand is 0.
+            if (right.getNumber() == 0) {
+                throw RuntimeError(op, "Division by 0.");
+            }
+            double quotient = left.getNumber() / right.getNumber();
+            // Keeps e.g. `n / 2` of an even integer an integer.
+            return left.isInteger() && right.isInteger() ? Object::Number(quotient) : Object(quotient);
+        } else if constexpr (Op == TOKEN_STAR) {
+            return Object(left.getNumber() * right.getNumber());
+        } else if constexpr (Op == TOKEN_GREATER) {
+            return Object(left.getNumber() > right.getNumber());
+        } else if constexpr (Op == TOKEN_GREATER_EQUAL) {
+            return Object(left.getNumber() >= right.getNumber());
+        } else if constexpr (Op == TOKEN_LESS) {
+            return Object(left.getNumber() < right.getNumber());
+        } else {
+            static_assert(Op == TOKEN_LESS_EQUAL, "Not a binary operator.");
+            return Object(left.getNumber() <= right.getNumber());
+        }
+    }
+}
+
+template<TokenType Op>
+Object unary(Interpreter& interpreter, const Token& op, const Object& right) {
+    if constexpr (Op == TOKEN_MINUS) {
+        // -0 and -INT32_MIN aren't int32s.
+        if (right.isInteger() && right.getInteger() != 0 && right.getInteger() != INT32_MIN) {
+            return Object::Integer(-right.getInteger());
+        }
+        // Ensure that the right-hand side operand is a number.
+        interpreter.checkNumberOperand(op, right);
+        return Object(-right.getNumber());
+    } else {
+        static_assert(Op == TOKEN_BANG, "Not a unary operator.");
+        return Object(!interpreter.isTruthy(right));
+    }
+}
+
+}
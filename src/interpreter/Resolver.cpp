@@ -1,5 +1,6 @@
 #include "Resolver.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "RuntimeError.h"
@@ -24,89 +25,152 @@ void Resolver::resolve(Expr* expr) {
     expr->accept(*this);
 }
 
-void Resolver::resolveLocal(const Expr& expr, const Token &identifier) {
-    if (scopes.empty())
-        return;
-
-    // Look for a variable starting from the innermost scope.
-    int i = 0;
-    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
-    {
-        // If variable is found, then we resolve it.
-        if (scope->find(identifier.lexeme) != scope->end())
-        {
-//            distances[&expr] = scopes.size() - i - 1; //number of hops when resolving variable // remove this line and keep next ????
-            m_Interpreter.resolve(const_cast<Expr *>(&expr), std::distance(scopes.rbegin(), scope));
-            return;
+Resolver::Resolution Resolver::resolveName(const std::string& name) {
+    // Look for a variable starting from the innermost scope, down to the current function's parameters.
+    size_t base = functions.empty() ? 0 : functions.back().base;
+    for (size_t i = scopes.size(); i-- > base;) {
+        auto binding = scopes[i].find(name);
+        if (binding != scopes[i].end()) {
+            return Resolution{Resolution::LOCAL, binding->second.slot, -1, &binding->second};
+        }
+    }
+
+    if (!functions.empty()) {
+        int index = resolveUpvalue(functions.size() - 1, name);
+        if (index != -1) {
+            return Resolution{Resolution::UPVALUE, -1, index, nullptr};
         }
-        i++;
     }
     // ... If never found, we can assume that the variable is global.
+    return Resolution{Resolution::GLOBAL, -1, -1, nullptr};
+}
+
+int Resolver::resolveUpvalue(size_t function, const std::string& name) {
+    // The enclosing function's scopes, or every scope outside the outermost function.
+    size_t base = functions[function].base;
+    size_t enclosingBase = function == 0 ? 0 : functions[function - 1].base;
+    for (size_t i = base; i-- > enclosingBase;) {
+        auto binding = scopes[i].find(name);
+        if (binding != scopes[i].end()) {
+            Binding& captured = binding->second;
+            captured.captured = captured.captured || !captured.readOnly;
+            return addUpvalue(function, UpvalueSource{true, captured.readOnly, captured.slot, -1});
+        }
+    }
+
+    if (function == 0) {
+        return -1;
+    }
+    int index = resolveUpvalue(function - 1, name);
+    if (index == -1) {
+        return -1;
+    }
+    return addUpvalue(function, UpvalueSource{false, false, -1, index});
+}
+
+int Resolver::addUpvalue(size_t function, const UpvalueSource& source) {
+    std::vector<UpvalueSource>& upvalues = *functions[function].upvalues;
+    for (size_t i = 0; i < upvalues.size(); i++) {
+        const UpvalueSource& existing = upvalues[i];
+        if (existing.isLocal == source.isLocal && existing.slot == source.slot && existing.index == source.index) {
+            return static_cast<int>(i);
+        }
+    }
+    upvalues.push_back(source);
+    return static_cast<int>(upvalues.size() - 1);
 }
 
 void Resolver::resolveFunction(Function& function, FunctionType type) {
     FunctionType enclosingFunction = currentFunction;
     currentFunction = type;
-
-    beginScope();
-    for (const Token& param : function.m_Params) {
-        declare(param);
-        define(param);
-    }
-    resolve(function.m_Body);
-    endScope();
+    resolveFunctionBody(function, type == METHOD || type == INITIALIZER);
     currentFunction = enclosingFunction; // ???
 }
 
 void Resolver::resolveFunction(AnonFunction& function) {
+    FunctionType enclosingFunction = currentFunction;
+    currentFunction = FUNCTION;
+    resolveFunctionBody(function, false);
+    currentFunction = enclosingFunction;
+}
+
+template<typename FunctionNode>
+void Resolver::resolveFunctionBody(FunctionNode& function, bool hasThis) {
+    int enclosingNextSlot = nextSlot;
+    int enclosingFrameSize = frameSize;
+    nextSlot = 0;
+    frameSize = 0;
+
     beginScope();
+    functions.push_back(FunctionScope{scopes.size() - 1, &function.m_Upvalues});
+    if (hasThis) {
+        // The receiver takes slot 0 of a method's frame.
+        Binding thisBinding{true, allocateSlot()};
+        thisBinding.readOnly = true;
+        scopes.back()["this"] = thisBinding;
+    }
     for (const Token& param : function.m_Params) {
         declare(param);
         define(param);
     }
     resolve(function.m_Body);
+
+    for (const Token& param : function.m_Params) {
+        const Binding& binding = scopes.back()[param.lexeme];
+        if (binding.captured) {
+            function.m_CapturedParams.push_back(binding.slot);
+        }
+    }
+    functions.pop_back();
     endScope();
+
+    function.m_FrameSize = frameSize;
+    nextSlot = enclosingNextSlot;
+    frameSize = enclosingFrameSize;
 }
 
-void Resolver::declare(const Token& name) {
-    if (scopes.empty()) return;
+int Resolver::declare(const Token& name, bool* isCaptured) {
+    if (scopes.empty()) return -1;
 
     // Get the innermost scope.
-    std::unordered_map<std::string, bool> scope = scopes.back();
+    std::unordered_map<std::string, Binding>& scope = scopes.back();
 
     // Don't allow the same variable declaration more than once.
-    if (scope.find(name.lexeme) != scope.end()) {
+    auto existing = scope.find(name.lexeme);
+    if (existing != scope.end()) {
         ErrorReporter::error(name.line, "Variable with this name already declared in this scope.");
         hadResolutionError = true;
+        existing->second.defined = false;
+        if (isCaptured != nullptr) {
+            existing->second.cellFlags.push_back(isCaptured);
+        }
+        return existing->second.slot;
     }
 
+    int slot = allocateSlot();
+    Binding& binding = scope[name.lexeme] = Binding{false, slot};
+    if (isCaptured != nullptr) {
+        binding.cellFlags.push_back(isCaptured);
+    }
+    return slot;
+}
 
-    // The m_Value associated with a key in the scope map represents whether we have completed
-    // resolving the initializer for that variable.
-    //scope.try_emplace(identifier.lexeme, false);
-
-    scope[name.lexeme] = false;
-    scopes.pop_back();
-    scopes.emplace_back(scope);
+int Resolver::allocateSlot() {
+    frameSize = std::max(frameSize, nextSlot + 1);
+    return nextSlot++;
 }
 
 void Resolver::define(const Token& name) {
     if (scopes.empty()) return;
 
-    // Indicates that the variable has been fully initialized by setting the m_Value to true.
-    //scopes.back()[identifier.lexeme] = true;
-
-    // Get the innermost scope.
-    std::unordered_map<std::string, bool> scope = scopes.back();
-
-    scope[name.lexeme] = true;
-    scopes.pop_back();
-    scopes.emplace_back(scope);
+    // Indicates that the variable has been fully initialized.
+    scopes.back()[name.lexeme].defined = true;
 }
 
 void Resolver::beginScope() {
-    scopes.push_back(std::unordered_map<std::string, bool>()); // change to emplace_back ???
+    scopes.push_back(std::unordered_map<std::string, Binding>()); // change to emplace_back ???
     usages.push_back(std::unordered_map<std::string, int>()); // change to emplace_back ???
+    scopeFirstSlots.push_back(nextSlot);
 }
 
 void Resolver::endScope() {
@@ -117,7 +181,20 @@ void Resolver::endScope() {
             ErrorReporter::warning(warningMessage.c_str());
         }
     }
+
+    // Every access to a captured variable from its own function goes through its cell.
+    for (auto& pair : scopes.back()) {
+        if (pair.second.captured) {
+            for (bool* flag : pair.second.cellFlags) {
+                *flag = true;
+            }
+        }
+    }
     scopes.pop_back();
+
+    // Nothing refers to the scope's slots anymore, so the next scope of the frame reuses them.
+    nextSlot = scopeFirstSlots.back();
+    scopeFirstSlots.pop_back();
 }
 
 void Resolver::increaseUsage(const Token& name) {
@@ -158,6 +235,9 @@ Object Resolver::visitGroupingExpr(Grouping& expr) {
 
 Object Resolver::visitCallExpr(Call& expr) {
     resolve(expr.m_Callee.get());
+    if (auto callee = dynamic_cast<Variable*>(expr.m_Callee.get())) {
+        expr.m_CalleeGlobal = callee->m_GlobalIndex;
+    }
 
     for (const auto& argument : expr.m_Arguments) {
         resolve(argument.get());
@@ -177,7 +257,15 @@ Object Resolver::visitGetExpr(Get& expr) {
 
 Object Resolver::visitAssignExpr(Assign& expr) {
     resolve(expr.m_Value.get());
-    resolveLocal(expr, expr.m_Name);
+    Resolution resolution = resolveName(expr.m_Name.lexeme);
+    if (resolution.kind == Resolution::LOCAL) {
+        expr.m_Slot = resolution.slot;
+        resolution.binding->cellFlags.push_back(&expr.m_InCell);
+    } else if (resolution.kind == Resolution::UPVALUE) {
+        expr.m_Upvalue = resolution.upvalue;
+    } else {
+        expr.m_GlobalIndex = m_Interpreter.getGlobals().indexOf(expr.m_Name.lexeme);
+    }
 
     increaseUsage(expr.m_Name);
     return Object::Null();
@@ -195,7 +283,15 @@ Object Resolver::visitThisExpr(This& expr) {
         hadResolutionError = true;
         return Object::Null();
     }
-    resolveLocal(expr, expr.m_Keyword);
+    // Keyword tokens don't carry their lexeme, so look the binding up by name.
+    Resolution resolution = resolveName("this");
+    if (resolution.kind == Resolution::UPVALUE) {
+        expr.m_Upvalue = resolution.upvalue;
+    } else if (resolution.kind == Resolution::GLOBAL) {
+        // Static methods are the only place inside a class without a "this".
+        ErrorReporter::error(expr.m_Keyword.line, "Cannot use 'this' in a static method.");
+        hadResolutionError = true;
+    }
     return Object::Null();
 }
 
@@ -207,7 +303,18 @@ Object Resolver::visitSuperExpr(Super& expr) {
         ErrorReporter::error(expr.m_Keyword.line, "Cannot use 'super' in a class with no superclass.");
         hadResolutionError = true;
     }
-    resolveLocal(expr, expr.m_Keyword);
+    // Keyword tokens don't carry their lexeme, so look the bindings up by name. "super" is declared outside the methods,
+    // so it's always an upvalue. There's no "this" in a static method, which is a runtime error.
+    expr.m_Upvalue = resolveName("super").upvalue;
+    Resolution receiver = resolveName("this");
+    if (receiver.kind == Resolution::LOCAL) {
+        expr.m_InMethod = true;
+    } else if (receiver.kind == Resolution::UPVALUE) {
+        expr.m_ThisUpvalue = receiver.upvalue;
+    }
+    if (currentClassStmt != nullptr) {
+        currentClassStmt->m_SuperExprs.push_back(&expr);
+    }
     return Object::Null();
 }
 
@@ -220,13 +327,21 @@ Object Resolver::visitVariableExpr(Variable& expr) {
     if (!scopes.empty()) {
         auto last = scopes.back();
         auto searched = last.find(expr.m_VariableName.lexeme);
-        if (searched != last.end() && !searched->second) {
+        if (searched != last.end() && !searched->second.defined) {
             ErrorReporter::error(expr.m_VariableName.line, "Cannot read local variable in its own initializer.");
             hadResolutionError = true;
         }
     }
 
-    resolveLocal(expr, expr.m_VariableName);
+    Resolution resolution = resolveName(expr.m_VariableName.lexeme);
+    if (resolution.kind == Resolution::LOCAL) {
+        expr.m_Slot = resolution.slot;
+        resolution.binding->cellFlags.push_back(&expr.m_InCell);
+    } else if (resolution.kind == Resolution::UPVALUE) {
+        expr.m_Upvalue = resolution.upvalue;
+    } else {
+        expr.m_GlobalIndex = m_Interpreter.getGlobals().indexOf(expr.m_VariableName.lexeme);
+    }
     increaseUsage(expr.m_VariableName);
     return Object::Null();
 }
@@ -238,6 +353,16 @@ Object Resolver::visitTernaryExpr(Ternary& expr) {
     return Object::Null();
 }
 
+Object Resolver::visitSpawnExpr(Spawn& expr) {
+    resolve(expr.m_Call.get());
+    return Object::Null();
+}
+
+Object Resolver::visitAwaitExpr(Await& expr) {
+    resolve(expr.m_Future.get());
+    return Object::Null();
+}
+
 // STATEMENTS
 
 void Resolver::visitExpressionStmt(Expression& stmt) {
@@ -256,6 +381,17 @@ void Resolver::visitReturnStmt(Return& stmt) {
             hadResolutionError = true;
         }
         resolve(stmt.m_Value->get());
+
+        // `return f(...)` (optionally parenthesized) doesn't need the caller's frame anymore once f is called.
+        if (currentFunction != FUNCTION_NONE && currentFunction != INITIALIZER && currentFunction != MEMO_FUNCTION) {
+            Expr* value = stmt.m_Value->get();
+            while (auto grouping = dynamic_cast<Grouping*>(value)) {
+                value = grouping->m_Expression.get();
+            }
+            if (auto call = dynamic_cast<Call*>(value)) {
+                call->m_IsTailCall = true;
+            }
+        }
     }
 }
 
@@ -270,7 +406,10 @@ void Resolver::visitBreakStmt(Break& stmt) {
 }
 
 void Resolver::visitLetStmt(Let& stmt) {
-    declare(stmt.m_Name);
+    if (scopes.empty()) {
+        stmt.m_GlobalIndex = m_Interpreter.getGlobals().indexOf(stmt.m_Name.lexeme);
+    }
+    stmt.m_Slot = declare(stmt.m_Name, &stmt.m_IsCaptured);
     if (stmt.m_Initializer.has_value()) {
         resolve(stmt.m_Initializer->get());
     }
@@ -303,9 +442,12 @@ void Resolver::visitBlockStmt(Block& stmt) {
 }
 
 void Resolver::visitFunctionStmt(Function& stmt) {
-    declare(stmt.m_Name);
+    if (scopes.empty()) {
+        stmt.m_GlobalIndex = m_Interpreter.getGlobals().indexOf(stmt.m_Name.lexeme);
+    }
+    stmt.m_Slot = declare(stmt.m_Name, &stmt.m_IsCaptured);
     define(stmt.m_Name);
-    resolveFunction(stmt, FUNCTION);
+    resolveFunction(stmt, stmt.m_MemoCapacity != 0 ? MEMO_FUNCTION : FUNCTION);
 }
 
 void Resolver::visitPrintStmt(Print& stmt) {
@@ -316,8 +458,14 @@ void Resolver::visitPrintStmt(Print& stmt) {
 void Resolver::visitClazzStmt(Class& stmt) {
     ClassType enclosingClass = currentClass;
     currentClass = ClassType::CLASS;
+    Class* enclosingClassStmt = currentClassStmt;
+    currentClassStmt = &stmt;
+    stmt.m_SuperExprs.clear();
 
-    declare(stmt.m_Name);
+    if (scopes.empty()) {
+        stmt.m_GlobalIndex = m_Interpreter.getGlobals().indexOf(stmt.m_Name.lexeme);
+    }
+    stmt.m_Slot = declare(stmt.m_Name, &stmt.m_IsCaptured);
     define(stmt.m_Name);
 
     if (stmt.m_Superclass.has_value() &&
@@ -333,25 +481,17 @@ void Resolver::visitClazzStmt(Class& stmt) {
 
     if (stmt.m_Superclass.has_value()) {
         beginScope();
-        auto backed = scopes.back();
-        backed["super"] = true;
-        scopes.pop_back();
-        scopes.emplace_back(backed);
+        stmt.m_SuperSlot = allocateSlot();
+        Binding superBinding{true, stmt.m_SuperSlot};
+        superBinding.readOnly = true;
+        scopes.back()["super"] = superBinding;
     }
 
-    // Start new scope for processing static methods
-    beginScope();
+    // Methods are created in the class' environment (or its "super" environment). Instance methods bind "this" in
+    // their own parameter scope.
     for (const auto& staticMethod : stmt.m_StaticMethods) {
-        resolveFunction(*staticMethod, FunctionType::METHOD);
+        resolveFunction(*staticMethod, FunctionType::STATIC_METHOD);
     }
-    endScope();
-
-    // Start new scope to process instance methods
-    beginScope();
-    auto back = scopes.back();
-    back["this"] = true;
-    scopes.pop_back();
-    scopes.emplace_back(back);
 
     for (const auto& method : stmt.m_Methods) {
         FunctionType declaration = FunctionType::METHOD;
@@ -361,9 +501,8 @@ void Resolver::visitClazzStmt(Class& stmt) {
         resolveFunction(*method, declaration);
     }
 
-    endScope();
-
     if (stmt.m_Superclass.has_value()) endScope();
 
     currentClass = enclosingClass; // ????
+    currentClassStmt = enclosingClassStmt;
 }
\ No newline at end of file
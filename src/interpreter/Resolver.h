@@ -19,8 +19,11 @@ private:
     enum FunctionType {
         FUNCTION_NONE,
         FUNCTION,
+        // A `@memo` function, which makes no tail calls so that every result passes through its cache.
+        MEMO_FUNCTION,
         METHOD,
-        INITIALIZER
+        INITIALIZER,
+        STATIC_METHOD
     };
     enum ClassType {
         CLASS_NONE,
@@ -29,6 +32,7 @@ private:
     };
     ClassType currentClass = CLASS_NONE;
     FunctionType currentFunction = FUNCTION_NONE;
+    Class* currentClassStmt = nullptr;
 
     Interpreter& m_Interpreter;
 
@@ -36,7 +40,41 @@ private:
 
     int loopNestingLevel = 0;
 
-    std::vector<std::unordered_map<std::string, bool>> scopes;
+    struct Binding {
+        // Whether we have finished resolving the variable's initializer.
+        bool defined;
+        // Slot of the variable in its function's frame.
+        int slot;
+        // "this" and "super" can't be assigned, so closures capture a copy of them instead of a cell.
+        bool readOnly = false;
+        // Whether a nested function captures the variable.
+        bool captured = false;
+        // The declaration's m_IsCaptured and the m_InCell of every use within the declaring function. Uses resolved
+        // before the variable gets captured need the flag as well, so they're all set when the scope ends.
+        std::vector<bool*> cellFlags = {};
+    };
+    std::vector<std::unordered_map<std::string, Binding>> scopes;
+    // Next free slot of the frame of the function being resolved (or of top-level code) and the number of slots the
+    // frame needs so far. Every scope allocates its variables from the frame and gives them back when it ends.
+    int nextSlot = 0;
+    int frameSize = 0;
+    std::vector<int> scopeFirstSlots;
+
+    struct FunctionScope {
+        // Index in `scopes` of the function's parameter scope.
+        size_t base;
+        std::vector<UpvalueSource>* upvalues;
+    };
+    // The functions being resolved, innermost last.
+    std::vector<FunctionScope> functions;
+
+    // What a name refers to from the current scope.
+    struct Resolution {
+        enum Kind {LOCAL, UPVALUE, GLOBAL} kind;
+        int slot;
+        int upvalue;
+        Binding* binding;
+    };
     std::vector<std::unordered_map<std::string, int>> usages;
 public:
     Resolver(Interpreter& interpreter);
@@ -62,6 +100,8 @@ public:
     Object visitUnaryExpr(Unary& expr) override;
     Object visitVariableExpr(Variable& expr) override;
     Object visitTernaryExpr(Ternary& expr) override;
+    Object visitSpawnExpr(Spawn& expr) override;
+    Object visitAwaitExpr(Await& expr) override;
 
     void visitExpressionStmt(Expression& stmt) override;
     void visitReturnStmt(Return& stmt) override;
@@ -82,8 +122,20 @@ private:
 
     void resolveFunction(Function& function, FunctionType type);
     void resolveFunction(AnonFunction& function);
-    void resolveLocal(const Expr& expr, const Token& identifier);
-
-    void declare(const Token& name);
+    // What's common to Function and AnonFunction: a frame of their own with "this" (for methods) and the parameters.
+    template<typename FunctionNode>
+    void resolveFunctionBody(FunctionNode& function, bool hasThis);
+    // Looks `name` up in the current function's scopes first, then in the enclosing functions', and otherwise takes
+    // it to be a global.
+    Resolution resolveName(const std::string& name);
+    // Index of `name` in the upvalues of functions[function], adding it (and whatever the enclosing functions need to
+    // pass it down) if it isn't there yet. -1 if no enclosing function declares it.
+    int resolveUpvalue(size_t function, const std::string& name);
+    int addUpvalue(size_t function, const UpvalueSource& source);
+
+    // Returns the slot the name gets in the innermost scope, or -1 at the top level.
+    int declare(const Token& name, bool* isCaptured = nullptr);
+    // Takes the next free slot of the current frame.
+    int allocateSlot();
     void define(const Token& name);
 };
\ No newline at end of file
@@ -3,10 +3,13 @@
 #include <stdexcept>
 #include <any>
 #include <memory>
+#include <vector>
 
 #include "../lexer/Token.h"
 #include "../util/Object.h"
 
+class Environment;
+
 class RuntimeError : std::runtime_error {
 private:
     std::string message;
@@ -25,7 +28,7 @@ public:
     }
 
     explicit RuntimeError(const std::string& message, int line = -1)
-            : std::runtime_error{message}, token{token}
+            : std::runtime_error{message}, token{}
     {
         if (line != -1){
             this->message = "[Line " + std::to_string(line) + "] " + message;
@@ -46,11 +49,11 @@ public:
             : RuntimeError(token, "Cannot break outside of a loop."){};
 };
 
-class ReturnException : public RuntimeError {
-public:
-    Object m_Value;
+// Thrown by ExecutionBudget when a script runs out of steps, time or memory. It's a regular RuntimeError so it unwinds
+// and gets reported like any other runtime error, but it can be told apart by whoever embeds the interpreter.
+class BudgetExceededError : public RuntimeError
+{
 public:
-    explicit ReturnException(Object value) : RuntimeError(), m_Value{std::move(value)} {};
-
-    //const Object& getReturnValue() const { return m_Value; }
+    explicit BudgetExceededError(const std::string& message)
+            : RuntimeError(message){};
 };
\ No newline at end of file
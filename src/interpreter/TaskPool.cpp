@@ -0,0 +1,122 @@
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+    // Index of the worker running on this thread, -1 on any other thread.
+    thread_local int currentWorker = -1;
+}
+
+TaskPool::TaskPool() {
+    size_t count = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < count; i++) {
+        m_Workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < count; i++) {
+        m_Threads.emplace_back(&TaskPool::work, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Stopping = true;
+    }
+    m_WakeUp.notify_all();
+    for (std::thread& thread : m_Threads) {
+        thread.join();
+    }
+}
+
+TaskPool& TaskPool::getInstance() {
+    static TaskPool pool;
+    return pool;
+}
+
+void TaskPool::submit(Task task) {
+    size_t index = currentWorker != -1 ? static_cast<size_t>(currentWorker) : m_NextWorker++ % m_Workers.size();
+    // Counted before it's queued, so taking it can't bring the count below zero.
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Queued++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Workers[index]->mutex);
+        m_Workers[index]->tasks.push_back(std::move(task));
+    }
+    m_WakeUp.notify_one();
+}
+
+void TaskPool::runUntil(const std::function<bool()>& done) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_WakeUp.wait(lock, [&] { return done() || m_Queued.load() != 0; });
+            if (done()) {
+                return;
+            }
+        }
+        runOne();
+    }
+}
+
+void TaskPool::notify() {
+    // Taking the lock orders the change `done` checks before a waiter going to sleep, so the wake-up can't be lost.
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+    }
+    m_WakeUp.notify_all();
+}
+
+bool TaskPool::take(Task& task) {
+    size_t count = m_Workers.size();
+    size_t first = 0;
+    if (currentWorker != -1) {
+        Worker& own = *m_Workers[currentWorker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            m_Queued--;
+            return true;
+        }
+        first = currentWorker + 1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Worker& victim = *m_Workers[(first + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_Queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskPool::runOne() {
+    Task task;
+    if (!take(task)) {
+        // Another thread took it first, or it's counted but not queued yet.
+        return false;
+    }
+    task();
+    return true;
+}
+
+void TaskPool::work(size_t index) {
+    currentWorker = static_cast<int>(index);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_WakeUp.wait(lock, [this] { return m_Queued.load() != 0 || m_Stopping; });
+            if (m_Queued.load() == 0) {
+                return;
+            }
+        }
+        runOne();
+    }
+}
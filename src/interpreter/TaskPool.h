@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Worker threads, one per hardware thread, running tasks from a deque of their own.
+ *
+ * A task submitted from a worker goes onto that worker's deque, and one submitted from any other thread onto the
+ * deques in turn. A worker runs the newest task of its own deque first and, when it's empty, steals the oldest task of
+ * another worker's, so idle workers take over the work a busy one has queued up while the busy one keeps working on
+ * what it submitted last.
+ *
+ * The threads are started the first time the pool is used and stop (after running whatever is still queued) when the
+ * program exits.
+ * */
+class TaskPool {
+public:
+    // A task must not throw: whoever submits it catches what it needs to hand back.
+    using Task = std::function<void()>;
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_Workers;
+    std::vector<std::thread> m_Threads;
+    std::atomic<size_t> m_NextWorker{0};
+
+    // Idle workers and threads waiting in runUntil() sleep on m_WakeUp until a task is queued (or, for a waiting
+    // thread, what it waits for has happened).
+    std::mutex m_SleepMutex;
+    std::condition_variable m_WakeUp;
+    // Tasks submitted and not taken yet.
+    std::atomic<size_t> m_Queued{0};
+    bool m_Stopping = false;
+
+    TaskPool();
+public:
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    static TaskPool& getInstance();
+
+    size_t workerCount() const {
+        return m_Workers.size();
+    }
+
+    void submit(Task task);
+
+    /* Runs queued tasks on the calling thread until `done` returns true, sleeping while there are none. A thread that
+     * waits for tasks this way keeps the pool busy instead of blocking one of its workers, so a task can wait for
+     * tasks it submitted itself. `done` is called with the pool's lock held, and whatever makes it true has to call
+     * notify() afterwards. */
+    void runUntil(const std::function<bool()>& done);
+
+    // Wakes up the threads waiting in runUntil() to check on what they wait for.
+    void notify();
+
+private:
+    // Takes a task from the calling worker's own deque, or steals one from another worker's.
+    bool take(Task& task);
+    bool runOne();
+    void work(size_t index);
+};
@@ -2,6 +2,7 @@
 #include <chrono>
 #include <iostream>
 #include <math.h>
+#include <cmath>
 #include <algorithm>
 #include <cctype>
 #include <string>
@@ -9,14 +10,21 @@
 #include <stdexcept>
 #include <thread>
 #include <sstream>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include "../Interpreter.h"
 #include "../RuntimeError.h"
+#include "../TaskPool.h"
 #include "../../lexer/lexer.h"
+#include "../../util/Concurrency.h"
 
 class Interpreter;
 
-stdlibFunctions::Clock::Clock() : KarolaScriptCallable(CallableType::FUNCTION) {}
+stdlibFunctions::Clock::Clock() : KarolaScriptCallable(CallableType::NATIVE) {}
 
-Object stdlibFunctions::Clock::call(Interpreter &interpreter, const std::vector<Object> &arguments) {
+Object stdlibFunctions::Clock::call(Interpreter &interpreter, Arguments arguments) {
     using namespace std::chrono;
     double ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
     std::cout << ms << std::endl;
@@ -35,9 +43,9 @@ std::string stdlibFunctions::Clock::name() {
     return "clock";
 }
 
-stdlibFunctions::Sleep::Sleep() : KarolaScriptCallable(CallableType::FUNCTION) {}
+stdlibFunctions::Sleep::Sleep() : KarolaScriptCallable(CallableType::NATIVE) {}
 
-Object stdlibFunctions::Sleep::call(Interpreter &interpreter, const std::vector<Object> &arguments) {
+Object stdlibFunctions::Sleep::call(Interpreter &interpreter, Arguments arguments) {
     int time;
     try {
         time = (int) arguments[0].getNumber();
@@ -61,9 +69,9 @@ std::string stdlibFunctions::Sleep::name() {
     return "sleep";
 }
 
-stdlibFunctions::Input::Input() : KarolaScriptCallable(CallableType::FUNCTION) {}
+stdlibFunctions::Input::Input() : KarolaScriptCallable(CallableType::NATIVE) {}
 
-Object stdlibFunctions::Input::call(Interpreter &interpreter, const std::vector<Object> &arguments) {
+Object stdlibFunctions::Input::call(Interpreter &interpreter, Arguments arguments) {
     std::string input;
     std::getline(std::cin, input);
     return Object(input);
@@ -81,13 +89,13 @@ std::string stdlibFunctions::Input::name() {
     return "input";
 }
 
-stdlibFunctions::ToUpper::ToUpper() : KarolaScriptCallable(CallableType::FUNCTION) {}
+stdlibFunctions::ToUpper::ToUpper() : KarolaScriptCallable(CallableType::NATIVE) {}
 
-Object stdlibFunctions::ToUpper::call(Interpreter &interpreter, const std::vector<Object> &arguments) {
+Object stdlibFunctions::ToUpper::call(Interpreter &interpreter, Arguments arguments) {
     if (!arguments[0].isString())
         throw RuntimeError("toLower argument should be a string.");
 
-    std::string s = arguments[0].getString();
+    std::string s = arguments[0].getString().str();
 
     for (char& c : s) {
         c = std::toupper(c);
@@ -108,13 +116,17 @@ std::string stdlibFunctions::ToUpper::name() {
     return "toUpper";
 }
 
-stdlibFunctions::ToLower::ToLower() : KarolaScriptCallable(CallableType::FUNCTION) {}
+Effect stdlibFunctions::ToUpper::effect() {
+    return EFFECT_PURE;
+}
+
+stdlibFunctions::ToLower::ToLower() : KarolaScriptCallable(CallableType::NATIVE) {}
 
-Object stdlibFunctions::ToLower::call(Interpreter &interpreter, const std::vector<Object> &arguments) {
+Object stdlibFunctions::ToLower::call(Interpreter &interpreter, Arguments arguments) {
     if (!arguments[0].isString())
         throw RuntimeError("toLower argument should be a string.");
 
-    std::string s = arguments[0].getString();
+    std::string s = arguments[0].getString().str();
 
     for (char& c : s) {
         c = std::tolower(c);
@@ -135,9 +147,114 @@ std::string stdlibFunctions::ToLower::name() {
     return "toLower";
 }
 
-stdlibFunctions::Power::Power() : KarolaScriptCallable(CallableType::FUNCTION) {}
+Effect stdlibFunctions::ToLower::effect() {
+    return EFFECT_PURE;
+}
 
-Object stdlibFunctions::Power::call(Interpreter &interpreter, const std::vector<Object> &arguments) {
+stdlibFunctions::ParallelFor::ParallelFor() : KarolaScriptCallable(CallableType::NATIVE) {}
+
+namespace {
+    // Chunks per worker, so workers that finish early can steal some of a slower one's.
+    constexpr uint64_t CHUNKS_PER_WORKER = 4;
+    // The most iterations a loop can run: beyond that the indices aren't all representable.
+    constexpr double MAX_ITERATIONS = 9007199254740992.0;
+
+    struct ParallelLoop {
+        std::atomic<uint64_t> remainingChunks;
+        // The first iteration that failed and what it threw. Chunks starting after it are skipped.
+        std::atomic<uint64_t> failedIteration{UINT64_MAX};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        explicit ParallelLoop(uint64_t chunks) : remainingChunks(chunks) {}
+
+        void fail(uint64_t iteration, std::exception_ptr thrown) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (iteration < failedIteration.load()) {
+                failedIteration = iteration;
+                error = std::move(thrown);
+            }
+        }
+    };
+}
+
+Object stdlibFunctions::ParallelFor::call(Interpreter &interpreter, Arguments arguments) {
+    if (!arguments[0].isNumber() || !arguments[1].isNumber())
+        throw RuntimeError("parallelFor bounds should be numbers.");
+
+    const Object& bodyObject = arguments[2];
+    if (!bodyObject.isCallable() && !bodyObject.isAnonFunction())
+        throw RuntimeError("parallelFor body should be a function.");
+    SharedCallablePtr body = bodyObject.getCallable();
+    if (body->arity() != 1)
+        throw RuntimeError("parallelFor body should take one argument, the index.");
+    std::string sharedWrite = body->sharedWrite();
+    if (!sharedWrite.empty())
+        throw RuntimeError("parallelFor body can't write state other iterations can see, but " + sharedWrite + ".");
+
+    double start = arguments[0].getNumber();
+    double end = arguments[1].getNumber();
+    if (!std::isfinite(start) || !std::isfinite(end))
+        throw RuntimeError("parallelFor bounds should be finite.");
+    if (!(start < end))
+        return Object::Null();
+    double count = std::ceil(end - start);
+    if (!(count <= MAX_ITERATIONS))
+        throw RuntimeError("parallelFor can't run more than 2^53 iterations.");
+    auto iterations = static_cast<uint64_t>(count);
+
+    TaskPool& pool = TaskPool::getInstance();
+    uint64_t chunks = std::min(iterations, pool.workerCount() * CHUNKS_PER_WORKER);
+    ParallelLoop loop(chunks);
+    {
+        concurrency::TaskScope scope;
+        for (uint64_t chunk = 0; chunk < chunks; chunk++) {
+            // Split without multiplying first, which could overflow for a large count.
+            uint64_t from = iterations / chunks * chunk + std::min(chunk, iterations % chunks);
+            uint64_t to = iterations / chunks * (chunk + 1) + std::min(chunk + 1, iterations % chunks);
+            pool.submit([&interpreter, &body, &loop, start, from, to] {
+                if (from < loop.failedIteration.load()) {
+                    uint64_t iteration = from;
+                    try {
+                        Interpreter worker(interpreter);
+                        for (; iteration < to && iteration < loop.failedIteration.load(); iteration++) {
+                            Object index = Object::Number(start + static_cast<double>(iteration));
+                            body->call(worker, Arguments(&index, 1));
+                        }
+                    } catch (...) {
+                        loop.fail(iteration, std::current_exception());
+                    }
+                }
+                // `loop` may be gone as soon as the count reaches zero.
+                if (--loop.remainingChunks == 0) {
+                    TaskPool::getInstance().notify();
+                }
+            });
+        }
+        pool.runUntil([&loop] { return loop.remainingChunks.load() == 0; });
+    }
+
+    if (loop.error) {
+        std::rethrow_exception(loop.error);
+    }
+    return Object::Null();
+}
+
+int stdlibFunctions::ParallelFor::arity() {
+    return 3;
+}
+
+std::string stdlibFunctions::ParallelFor::toString() {
+    return "<native function " + name() + ">";
+}
+
+std::string stdlibFunctions::ParallelFor::name() {
+    return "parallelFor";
+}
+
+stdlibFunctions::Power::Power() : KarolaScriptCallable(CallableType::NATIVE) {}
+
+Object stdlibFunctions::Power::call(Interpreter &interpreter, Arguments arguments) {
     if (!arguments[0].isNumber() || !arguments[1].isNumber())
         throw RuntimeError("Both pwr argument should be a number.");
 
@@ -159,9 +276,13 @@ std::string stdlibFunctions::Power::name() {
     return "pwr";
 }
 
-stdlibFunctions::SqrRoot::SqrRoot() : KarolaScriptCallable(CallableType::FUNCTION) {}
+Effect stdlibFunctions::Power::effect() {
+    return EFFECT_PURE;
+}
+
+stdlibFunctions::SqrRoot::SqrRoot() : KarolaScriptCallable(CallableType::NATIVE) {}
 
-Object stdlibFunctions::SqrRoot::call(Interpreter &interpreter, const std::vector<Object> &arguments) {
+Object stdlibFunctions::SqrRoot::call(Interpreter &interpreter, Arguments arguments) {
     if (!arguments[0].isNumber())
         throw RuntimeError("toLower argument should be a string.");
 
@@ -178,4 +299,8 @@ std::string stdlibFunctions::SqrRoot::toString() {
 
 std::string stdlibFunctions::SqrRoot::name() {
     return "sqrr00t";
-}
\ No newline at end of file
+}
+
+Effect stdlibFunctions::SqrRoot::effect() {
+    return EFFECT_PURE;
+}
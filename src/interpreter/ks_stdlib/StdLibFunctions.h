@@ -12,7 +12,7 @@ namespace stdlibFunctions {
     class Clock : public KarolaScriptCallable {
     public:
         Clock();
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override;
+        Object call(Interpreter &interpreter, Arguments arguments) override;
         int arity() override;
         std::string toString() override;
         std::string name() override;
@@ -21,7 +21,7 @@ namespace stdlibFunctions {
     class Sleep : public KarolaScriptCallable {
     public:
         Sleep();
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override;
+        Object call(Interpreter &interpreter, Arguments arguments) override;
         int arity() override;
         std::string toString() override;
         std::string name() override;
@@ -30,7 +30,7 @@ namespace stdlibFunctions {
     class Input : public KarolaScriptCallable {
     public:
         Input();
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override;
+        Object call(Interpreter &interpreter, Arguments arguments) override;
         int arity() override;
         std::string toString() override;
         std::string name() override;
@@ -39,16 +39,31 @@ namespace stdlibFunctions {
     class ToUpper : public KarolaScriptCallable {
     public:
         ToUpper();
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override;
+        Object call(Interpreter &interpreter, Arguments arguments) override;
         int arity() override;
         std::string toString() override;
         std::string name() override;
+        Effect effect() override;
     };
 
     class ToLower : public KarolaScriptCallable {
     public:
         ToLower();
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override;
+        Object call(Interpreter &interpreter, Arguments arguments) override;
+        int arity() override;
+        std::string toString() override;
+        std::string name() override;
+        Effect effect() override;
+    };
+
+    /* parallelFor(start, end, body) calls body(i) for every i from start up to (not including) end, in chunks spread
+     * over the TaskPool, and returns once all of them have. Each chunk runs in an interpreter of its own, so iterations
+     * only share what the body captures or reads from globals, and the body can't write any of that (see
+     * EffectAnalyzer). An error raised by an iteration is raised again by parallelFor, after the others are done. */
+    class ParallelFor : public KarolaScriptCallable {
+    public:
+        ParallelFor();
+        Object call(Interpreter &interpreter, Arguments arguments) override;
         int arity() override;
         std::string toString() override;
         std::string name() override;
@@ -60,18 +75,20 @@ namespace stdlibFunctions {
     class Power : public KarolaScriptCallable {
     public:
         Power();
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override;
+        Object call(Interpreter &interpreter, Arguments arguments) override;
         int arity() override;
         std::string toString() override;
         std::string name() override;
+        Effect effect() override;
     };
 
     class SqrRoot : public KarolaScriptCallable {
     public:
         SqrRoot();
-        Object call(Interpreter &interpreter, const std::vector<Object> &arguments) override;
+        Object call(Interpreter &interpreter, Arguments arguments) override;
         int arity() override;
         std::string toString() override;
         std::string name() override;
+        Effect effect() override;
     };
 }
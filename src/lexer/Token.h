@@ -1,12 +1,14 @@
 #pragma once
 
+#include <string>
+
 enum TokenType {
 
     // Single-character tokens.
     TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,
     TOKEN_LEFT_BRACE, TOKEN_RIGHT_BRACE,
     TOKEN_COMMA, TOKEN_DOT, TOKEN_MINUS, TOKEN_PLUS,
-    TOKEN_SEMICOLON, TOKEN_SLASH, TOKEN_STAR, TOKEN_QUESTION_MARK, TOKEN_COLON,
+    TOKEN_SEMICOLON, TOKEN_SLASH, TOKEN_STAR, TOKEN_QUESTION_MARK, TOKEN_COLON, TOKEN_AT,
 
     // One or two character tokens.
     TOKEN_BANG, TOKEN_BANG_EQUAL,
@@ -20,7 +22,7 @@ enum TokenType {
     // Keywords.
     TOKEN_AND, TOKEN_CLAZZ, TOKEN_STATIC, TOKEN_ELSE, TOKEN_FALSE, TOKEN_FUNCT, TOKEN_FOR, TOKEN_IF, TOKEN_NULL, TOKEN_OR,
     TOKEN_KONSOLE, TOKEN_RETURN, TOKEN_SUPER, TOKEN_THIS, TOKEN_TRUE, TOKEN_LET, TOKEN_WHILE,
-    TOKEN_BREAK,
+    TOKEN_BREAK, TOKEN_SPAWN, TOKEN_AWAIT,
 
     TOKEN_EOF
 };
@@ -30,5 +32,6 @@ typedef struct Token {
     const char* start;
     int length;
     int line;
-    std::string lexeme;
+    std::string lexeme;     // empty for keywords, punctuation and numbers
+    double number = 0;      // value of a TOKEN_NUMBER, parsed by the lexer
 } Token;
\ No newline at end of file
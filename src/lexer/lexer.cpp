@@ -1,4 +1,10 @@
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <cstdint>
 #include <cstring>
+#include <string_view>
+#include <utility>
 
 #include "../util/ErrorReporter.h"
 #include "lexer.h"
@@ -20,22 +26,47 @@ void initLexer(const char* source) {
     program = source;
 }
 
+// Character classes, looked up in a table instead of compared against character ranges.
+enum CharClass : uint8_t {
+    CHAR_ALPHA = 1 << 0,    // letters and '_', which can start an identifier
+    CHAR_DIGIT = 1 << 1,
+    CHAR_HEX = 1 << 2,
+};
+
+static constexpr std::array<uint8_t, 256> buildCharClasses() {
+    std::array<uint8_t, 256> classes{};
+    for (int c = 0; c < 256; c++) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') classes[c] |= CHAR_ALPHA;
+        if (c >= '0' && c <= '9') classes[c] |= CHAR_DIGIT | CHAR_HEX;
+        if ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) classes[c] |= CHAR_HEX;
+    }
+    return classes;
+}
+
+static constexpr std::array<uint8_t, 256> charClasses = buildCharClasses();
+
+static bool hasClass(char c, uint8_t charClass) {
+    return (charClasses[static_cast<uint8_t>(c)] & charClass) != 0;
+}
+
 static bool isAlpha(char c) {
-    return (c >= 'a' && c <= 'z') ||
-           (c >= 'A' && c <= 'Z') ||
-           c == '_';
+    return hasClass(c, CHAR_ALPHA);
 }
 
 static bool isDigit(char c) {
-    return c >= '0' && c <= '9';
+    return hasClass(c, CHAR_DIGIT);
 }
 
-static bool isAtEnd() {
-    return *lexeme.current == '\0';
+static bool isHexDigit(char c) {
+    return hasClass(c, CHAR_HEX);
 }
 
-static bool isAtEndNext() {
-    return *(lexeme.current + 1) == '\0';
+static bool isBinaryDigit(char c) {
+    return c == '0' || c == '1';
+}
+
+static bool isAtEnd() {
+    return *lexeme.current == '\0';
 }
 
 static char advance() {
@@ -65,29 +96,25 @@ static Token makeToken(TokenType type) {
     token.start = lexeme.start;
     token.length = (int)(lexeme.current - lexeme.start);
     token.line = lexeme.line;
-    token.lexeme = "";
     return token;
 }
 
-static Token makeToken(TokenType type, const std::string& literal) {
-    Token token{};
-    token.type = type;
-    token.start = lexeme.start;
-    token.length = (int)(lexeme.current - lexeme.start);
-    token.line = lexeme.line;
-    token.lexeme = literal;
+// The lexeme is built in place in the token, so there's no temporary string to copy it from.
+static Token makeToken(TokenType type, const char* literal, size_t length) {
+    Token token = makeToken(type);
+    token.lexeme.assign(literal, length);
     return token;
 }
 
 
 // doesn't support nested comments !!!
 static void commentBlock() {
-    while (peek() != '*' && peekNext() != '/' && !isAtEndNext()) {
+    while (!(peek() == '*' && peekNext() == '/') && !isAtEnd()) {
         if (peek() == '\n') lexeme.line++;
         advance();
     }
 
-    if (isAtEndNext()) {
+    if (isAtEnd()) {
         ErrorReporter::error(lexeme.line, "Unterminated comment block.");
         return;
     }
@@ -111,11 +138,16 @@ static void skipWhitespace() {
                 advance();
                 break;
             case '/':
-                if (match('/')) {
+                if (peekNext() == '/') {
                     // A comment goes until the end of the line.
                     while (peek() != '\n' && !isAtEnd()) advance();
-                } else if (match('*')) {
+                } else if (peekNext() == '*') {
+                    advance();
+                    advance();
                     commentBlock();
+                } else {
+                    // A division, which scanToken() takes from here.
+                    return;
                 }
                 break;
             default:
@@ -124,69 +156,104 @@ static void skipWhitespace() {
     }
 }
 
-static TokenType checkKeyword(int start, int length, const char* rest, TokenType type) {
-    if (lexeme.current - lexeme.start == start + length &&
-        memcmp(lexeme.start + start, rest, length) == 0) {
-        return type;
-    }
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+static constexpr Keyword keywords[] = {
+        {"and", TOKEN_AND}, {"break", TOKEN_BREAK}, {"clazz", TOKEN_CLAZZ}, {"console", TOKEN_KONSOLE},
+        {"else", TOKEN_ELSE}, {"false", TOKEN_FALSE}, {"for", TOKEN_FOR}, {"funct", TOKEN_FUNCT}, {"if", TOKEN_IF},
+        {"let", TOKEN_LET}, {"null", TOKEN_NULL}, {"or", TOKEN_OR}, {"return", TOKEN_RETURN},
+        {"static", TOKEN_STATIC}, {"super", TOKEN_SUPER}, {"this", TOKEN_THIS}, {"true", TOKEN_TRUE},
+        {"while", TOKEN_WHILE}, {"spawn", TOKEN_SPAWN}, {"await", TOKEN_AWAIT},
+};
+
+/* Keywords are recognized with a perfect hash over (first char, last char, length): the table below is built from
+ * `keywords` at compile time and the static_assert fails the build if two keywords land in the same slot, in which
+ * case the multipliers need changing. An identifier costs one hash, one length compare and, only if the length
+ * matches, one memcmp.
+ * */
+static constexpr size_t KEYWORD_SLOTS = 32;
+
+static constexpr size_t keywordSlot(char first, char last, size_t length) {
+    return (static_cast<uint8_t>(first) * 7 + static_cast<uint8_t>(last) * 9 + length) & (KEYWORD_SLOTS - 1);
+}
 
-    return TOKEN_IDENTIFIER;
+struct KeywordTable {
+    Keyword slots[KEYWORD_SLOTS] = {};
+    bool hasCollision = false;
+};
+
+static constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table;
+    for (const Keyword& keyword : keywords) {
+        Keyword& slot = table.slots[keywordSlot(keyword.text.front(), keyword.text.back(), keyword.text.size())];
+        if (!slot.text.empty()) {
+            table.hasCollision = true;
+        }
+        slot = keyword;
+    }
+    return table;
 }
 
+static constexpr KeywordTable keywordTable = buildKeywordTable();
+static_assert(!keywordTable.hasCollision, "Two keywords share a slot in the keyword table.");
+
 static TokenType identifierType() {
-    switch (lexeme.start[0]) {
-        case 'a': return checkKeyword(1, 2, "nd", TOKEN_AND);
-        case 'b': return checkKeyword(1, 4, "reak", TOKEN_BREAK);
-        case 'c':
-            if (lexeme.current - lexeme.start > 1) {
-                switch (lexeme.start[1]) {
-                    case 'l': return checkKeyword(2, 3, "azz", TOKEN_CLAZZ);
-                    case 'o': return checkKeyword(2, 5, "nsole", TOKEN_KONSOLE);
-                }
-            }
-            break;
-        case 'e': return checkKeyword(1, 3, "lse", TOKEN_ELSE);
-        case 'f':
-            if (lexeme.current - lexeme.start > 1) {
-                switch (lexeme.start[1]) {
-                    case 'a': return checkKeyword(2, 3, "lse", TOKEN_FALSE);
-                    case 'o': return checkKeyword(2, 1, "r", TOKEN_FOR);
-                    case 'u': return checkKeyword(2, 3, "nct", TOKEN_FUNCT);
-                }
-            }
-            break;
-        case 'i': return checkKeyword(1, 1, "f", TOKEN_IF);
-        case 'n': return checkKeyword(1, 2, "ull", TOKEN_NULL);
-        case 'o': return checkKeyword(1, 1, "r", TOKEN_OR);
-        case 'r': return checkKeyword(1, 5, "eturn", TOKEN_RETURN);
-        case 's':
-            if (lexeme.current - lexeme.start > 1) {
-                switch (lexeme.start[1]) {
-                    case 'u': return checkKeyword(2, 3, "per", TOKEN_SUPER);
-                    case 't': return checkKeyword(2, 4, "atic", TOKEN_STATIC);
-                }
-            }
-            break;
-        case 't': return checkKeyword(1, 3, "rue", TOKEN_TRUE);
-        case 'l': return checkKeyword(1, 2, "et", TOKEN_LET);
-        case 'w': return checkKeyword(1, 4, "hile", TOKEN_WHILE);
+    auto length = static_cast<size_t>(lexeme.current - lexeme.start);
+    const Keyword& candidate = keywordTable.slots[keywordSlot(lexeme.start[0], lexeme.current[-1], length)];
+    if (candidate.text.size() == length && memcmp(candidate.text.data(), lexeme.start, length) == 0) {
+        return candidate.type;
     }
 
     return TOKEN_IDENTIFIER;
 }
 
 static Token identifier() {
-    while (isAlpha(peek()) || isDigit(peek())) advance();
+    while (hasClass(peek(), CHAR_ALPHA | CHAR_DIGIT)) advance();
 
     TokenType tokenType = identifierType();
     if (tokenType == TOKEN_IDENTIFIER) {
-        std::string literal(lexeme.start, (int)(lexeme.current - lexeme.start));
-        return makeToken(tokenType, literal);
+        return makeToken(tokenType, lexeme.start, lexeme.current - lexeme.start);
     }
     return makeToken(tokenType);
 }
 
+// Digits of a 0x/0b literal, after the prefix. Values past 2^64 are an error.
+static Token radixNumber(int base, bool (*isRadixDigit)(char), const char* name) {
+    const char* digits = lexeme.current;
+    while (isRadixDigit(peek())) advance();
+
+    Token token = makeToken(TOKEN_NUMBER);
+    if (digits == lexeme.current) {
+        ErrorReporter::error(lexeme.line, name);
+        return token;
+    }
+
+    uint64_t value = 0;
+    auto result = std::from_chars(digits, lexeme.current, value, base);
+    if (result.ec == std::errc::result_out_of_range) {
+        ErrorReporter::error(lexeme.line, "Number literal is too large.");
+    }
+    token.number = static_cast<double>(value);
+    return token;
+}
+
+/* Numbers are parsed here, once, so the token already carries the value and the parser builds the Literal straight
+ * from it. Number tokens don't get a lexeme. Besides decimals with an optional fraction and exponent (1, 1.5, 2e10,
+ * 1.5e-3), hexadecimal (0xFF) and binary (0b101) integers are supported.
+ * */
 static Token number() {
+    if (lexeme.start[0] == '0' && (peek() == 'x' || peek() == 'X')) {
+        advance();
+        return radixNumber(16, isHexDigit, "Expected hexadecimal digits after '0x'.");
+    }
+    if (lexeme.start[0] == '0' && (peek() == 'b' || peek() == 'B')) {
+        advance();
+        return radixNumber(2, isBinaryDigit, "Expected binary digits after '0b'.");
+    }
+
     while (isDigit(peek())) advance();
 
     // Look for a fractional part.
@@ -197,8 +264,23 @@ static Token number() {
         while (isDigit(peek())) advance();
     }
 
-    std::string literal(lexeme.start, (int)(lexeme.current - lexeme.start));
-    return makeToken(TOKEN_NUMBER, literal);
+    // Look for an exponent. Only consumed when digits follow, so `2e` stays a number followed by an identifier.
+    if (peek() == 'e' || peek() == 'E') {
+        const char* exponent = lexeme.current + 1;
+        if (*exponent == '+' || *exponent == '-') exponent++;
+        if (isDigit(*exponent)) {
+            lexeme.current = exponent;
+            while (isDigit(peek())) advance();
+        }
+    }
+
+    Token token = makeToken(TOKEN_NUMBER);
+    auto result = std::from_chars(lexeme.start, lexeme.current, token.number);
+    if (result.ec == std::errc::result_out_of_range) {
+        // from_chars leaves the value alone here. strtod gives the usual inf/0 for these.
+        token.number = std::strtod(lexeme.start, nullptr);
+    }
+    return token;
 }
 
 static Token string() {
@@ -207,13 +289,15 @@ static Token string() {
         advance();
     }
 
-    if (isAtEnd()) ErrorReporter::error(lexeme.line, "Unterminated string.");
+    if (isAtEnd()) {
+        ErrorReporter::error(lexeme.line, "Unterminated string.");
+        return makeToken(TOKEN_STRING, lexeme.start + 1, lexeme.current - lexeme.start - 1);
+    }
 
     // The closing quote.
     advance();
 
-    std::string literal(lexeme.start + 1, (int)(lexeme.current - lexeme.start ) - 2);
-    return makeToken(TOKEN_STRING, literal);
+    return makeToken(TOKEN_STRING, lexeme.start + 1, lexeme.current - lexeme.start - 2);
 }
 
 Token scanToken() {
@@ -240,6 +324,7 @@ Token scanToken() {
         case '*': return makeToken(TOKEN_STAR);
         case '?': return makeToken(TOKEN_QUESTION_MARK);
         case ':': return makeToken(TOKEN_COLON);
+        case '@': return makeToken(TOKEN_AT);
         case '!':
             return makeToken(
                     match('=') ? TOKEN_BANG_EQUAL : TOKEN_BANG);
@@ -256,6 +341,8 @@ Token scanToken() {
     }
 
     ErrorReporter::error(lexeme.line, "Unexpected character.");
+    // Skip it and carry on with the next token.
+    return scanToken();
 }
 
 std::vector<Token> scanTokens() {
@@ -266,5 +353,5 @@ std::vector<Token> scanTokens() {
     }
 
     tokens.push_back({TOKEN_EOF});
-    return tokens;
+    return std::move(tokens);
 }
\ No newline at end of file
@@ -1,14 +1,25 @@
 #include <string>
+#include <cstring>
 #include <iostream>
 
 #include "lexer/lexer.h"
 #include "parser/Parser.h"
 #include "interpreter/Interpreter.h"
 #include "interpreter/Resolver.h"
+#include "interpreter/EffectAnalyzer.h"
+#include "interpreter/ConstantFolder.h"
+#include "interpreter/Inliner.h"
+#include "interpreter/EscapeAnalyzer.h"
+#include "interpreter/ClosureCompiler.h"
 #include "interpreter/RuntimeError.h"
 
 Interpreter interpreter = Interpreter();
 Resolver resolver = Resolver(interpreter);
+EffectAnalyzer effectAnalyzer = EffectAnalyzer(interpreter);
+Inliner inliner = Inliner(interpreter);
+ConstantFolder constantFolder = ConstantFolder(interpreter);
+EscapeAnalyzer escapeAnalyzer = EscapeAnalyzer();
+ClosureCompiler closureCompiler = ClosureCompiler(interpreter);
 
 // Both the prompt and the file runner are thin wrappers around this core function
 static void run(const char* program) {
@@ -28,6 +39,15 @@ static void run(const char* program) {
     if (hadResolutionError)
         return;
 
+    effectAnalyzer.analyze(statements);
+
+    // Fold first so literal arguments like `f(2 * 3)` can be inlined, then again to fold what inlining exposed.
+    constantFolder.fold(statements);
+    inliner.inlineCalls(statements);
+    constantFolder.fold(statements);
+    escapeAnalyzer.analyze(statements);
+    closureCompiler.compile(statements);
+
 //    generator.generate();
     try {
         interpreter.interpret(statements);
@@ -96,22 +116,55 @@ static void runFile(const char* path) {
     free(source);
 }
 
+static void usage() {
+    fprintf(stderr, "Usage: ks [--max-steps=N] [--timeout-ms=N] [--max-memory=BYTES] [filePath]\n");
+    exit(64);
+}
+
+// Parses `--name=value` into `out`. Returns false if `arg` is not the given option.
+static bool parseLimitFlag(const char* arg, const char* name, uint64_t& out) {
+    size_t nameLength = strlen(name);
+    if (strncmp(arg, name, nameLength) != 0 || arg[nameLength] != '=')
+        return false;
+
+    char* end = nullptr;
+    out = strtoull(arg + nameLength + 1, &end, 10);
+    if (end == arg + nameLength + 1 || *end != '\0')
+        usage();
+    return true;
+}
+
 int main(int argc, const char* argv[]) {
 
     // Reference for used error exit codes: https://man.freebsd.org/cgi/man.cgi?query=sysexits&apropos=0&sektion=0&manpath=FreeBSD+4.3-RELEASE&format=html
 
 //    generator.generate();
 
-    if (argc == 1) {
+    ExecutionLimits limits;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        uint64_t memory = 0;
+        if (parseLimitFlag(argv[i], "--max-steps", limits.maxSteps) ||
+            parseLimitFlag(argv[i], "--timeout-ms", limits.timeoutMs)) {
+            continue;
+        }
+        if (parseLimitFlag(argv[i], "--max-memory", memory)) {
+            limits.maxMemoryBytes = memory;
+            continue;
+        }
+        if (argv[i][0] == '-' || path != nullptr)
+            usage();
+        path = argv[i];
+    }
+    interpreter.setLimits(limits);
+
+    if (path == nullptr) {
         repl();
-    } else if (argc == 2) {
-        runFile(argv[1]);
+    } else {
+        runFile(path);
 //        runFile("/home/marko/compilers/KarolaScript/src/resources/basics.ks");
 //        runFile("/home/marko/compilers/KarolaScript/src/resources/functions.ks");
 //        runFile("/home/marko/compilers/KarolaScript/src/resources/classes.ks");
-    } else {
-        fprintf(stderr, "Usage: ks [filePath]\n");
-        exit(64);
     }
 
     return 0;
@@ -4,6 +4,7 @@
 // TODO
 // Make some "LLVM IR CodeGenException"
 #include "../../interpreter/RuntimeError.h"
+#include "../../util/Utils.h"
 
 CodeGenVisitor::CodeGenVisitor() {
     moduleInit();
@@ -127,24 +128,18 @@ llvm::Value* CodeGenVisitor::visitBinaryExpr(Binary &expr) {
 
         case TOKEN_PLUS:
             if (leftObject.isString() && rightObject.isString()) {
-                return builder->CreateGlobalString(leftObject.getString() + rightObject.getString());
+                return builder->CreateGlobalString(leftObject.getString().str() + rightObject.getString().str());
             }
             else if (leftObject.isNumber() && rightObject.isNumber()) {
                 return builder->CreateAdd(left, right);
             }
             else if (leftObject.isNumber() && rightObject.isString()) {
-                // Remove trailing zeroes.
-                std::string num_as_string = std::to_string(leftObject.getNumber());
-                num_as_string.erase(num_as_string.find_last_not_of('0') + 1, std::string::npos);
-                num_as_string.erase(num_as_string.find_last_not_of('.') + 1, std::string::npos);
-                return builder->CreateGlobalString(num_as_string + rightObject.getString());
+                std::string num_as_string = utils::numberToString(leftObject.getNumber());
+                return builder->CreateGlobalString(num_as_string + rightObject.getString().str());
             }
             else if (leftObject.isString() && rightObject.isNumber()) {
-                // Remove trailing zeroes.
-                std::string num_as_string = std::to_string(rightObject.getNumber());
-                num_as_string.erase(num_as_string.find_last_not_of('0') + 1, std::string::npos);
-                num_as_string.erase(num_as_string.find_last_not_of('.') + 1, std::string::npos);
-                return builder->CreateGlobalString(leftObject.getString() + num_as_string);
+                std::string num_as_string = utils::numberToString(rightObject.getNumber());
+                return builder->CreateGlobalString(leftObject.getString().str() + num_as_string);
             }
 
             throw RuntimeError(expr.m_Operator, "Operands must be of type string or number.");
@@ -305,7 +300,7 @@ llvm::Value *CodeGenVisitor::gen(Object object) {
     if (object.isNumber())
         return builder->getInt64(object.getNumber());
     if (object.isString())
-        return builder->CreateGlobalString(object.getString());
+        return builder->CreateGlobalString(object.getString().str());
     if (object.isBoolean())
         return builder->getInt1(object.getBoolean());
 }
@@ -96,6 +96,8 @@ public:
     llvm::Value* visitUnaryExpr(Unary& expr) override;
     llvm::Value* visitVariableExpr(Variable& expr) override;
     llvm::Value* visitTernaryExpr(Ternary& expr) override;
+    llvm::Value* visitSpawnExpr(Spawn& expr) override;
+    llvm::Value* visitAwaitExpr(Await& expr) override;
 
     void visitExpressionStmt(Expression& stmt) override;
     void visitReturnStmt(Return& stmt) override;
@@ -6,6 +6,7 @@
 
 #include "../lexer/Token.h"
 #include "../util/Object.h"
+#include "../util/Symbols.h"
 #include "../util/common.h"
 
 #include "../middleware/KarolaScriptNamespace.h"
@@ -13,6 +14,7 @@
 //class Stmt;
 
 class Assign;
+class Await;
 class Binary;
 class Call;
 class AnonFunction;
@@ -21,12 +23,23 @@ class Grouping;
 class Literal;
 class Logical;
 class Set;
+class Spawn;
 class Super;
 class This;
 class Unary;
 class Ternary;
 class Variable;
 
+class Expr;
+class Interpreter;
+class KarolaScriptFunction;
+
+// Evaluation routine specialized for one node, installed by the ClosureCompiler.
+using ExprHandler = Object (*)(Interpreter& interpreter, Expr& expr);
+
+// Routine that calls one kind of callable with the arguments of a call site, cached on the Call node.
+using CallEntry = Object (*)(Interpreter& interpreter, const SharedCallablePtr& callee, Call& expr);
+
 template<typename R>
 class ExprVisitor {
 public:
@@ -45,10 +58,15 @@ public:
     virtual R visitUnaryExpr(Unary& expr) = 0;
     virtual R visitTernaryExpr(Ternary& expr) = 0;
     virtual R visitVariableExpr(Variable& expr) = 0;
+    virtual R visitSpawnExpr(Spawn& expr) = 0;
+    virtual R visitAwaitExpr(Await& expr) = 0;
 };
 
 class Expr {
 public:
+    // When set, Interpreter::evaluate calls this directly instead of dispatching through accept().
+    ExprHandler m_Handler = nullptr;
+
     virtual ~Expr() = default;
     virtual Object accept(ExprVisitor<Object>& visitor) = 0;
 
@@ -63,6 +81,14 @@ class Assign : public Expr {
 public:
     Token m_Name;
     UniqueExprPtr m_Value;
+    // Where the Resolver found the target: slot in the current function's frame for a local of the function, index in
+    // the function's upvalues for a variable of an enclosing function, or index in the interpreter's GlobalTable for a
+    // global. The others are -1. `m_InCell` is set for a local that some nested function captures, which lives in a
+    // cell instead of its slot.
+    int m_Slot = -1;
+    int m_Upvalue = -1;
+    int m_GlobalIndex = -1;
+    bool m_InCell = false;
 
     Assign(const Token& name, UniqueExprPtr value)
             : m_Name(name), m_Value(std::move(value)) {
@@ -93,6 +119,23 @@ public:
     UniqueExprPtr m_Callee;
     Token m_Paren;
     std::vector<UniqueExprPtr> m_Arguments;
+    // Set by the Resolver when the call is the whole value of a `return` inside a function, i.e. `return f(...)`.
+    bool m_IsTailCall = false;
+    // GlobalTable index of the callee when it's a global variable, set by the Resolver.
+    int m_CalleeGlobal = -1;
+
+    /* Monomorphic call cache, filled in by the interpreter: the callable called last time and the routine that calls
+     * it, picked with its kind and arity already checked (null for an arity error). For a global callee it also holds
+     * the global's version at that time, and as long as nothing has assigned the global since, the callee isn't even
+     * read. */
+    SharedCallablePtr m_CachedCallee;
+    CallEntry m_CachedEntry = nullptr;
+    uint32_t m_CachedVersion = 0;
+
+    // Set by the EscapeAnalyzer when the call initializes a local whose instance never leaves the frame. Constructing a
+    // class here then reuses the instance it created last time, kept in m_RecycledInstance, once that one is garbage.
+    bool m_NonEscaping = false;
+    SharedInstancePtr m_RecycledInstance;
 
     Call(UniqueExprPtr callee, const Token& paren, std::vector<UniqueExprPtr> arguments)
             : m_Callee(std::move(callee)), m_Paren(paren), m_Arguments(std::move(arguments)) {
@@ -107,6 +150,16 @@ class AnonFunction : public Expr {
 public:
     std::vector<Token> m_Params;
     std::vector<UniqueStmtPtr> m_Body;
+    // Variables of enclosing functions this one uses, in upvalue order, and the slots of its parameters that nested
+    // functions capture in turn. Both filled in by the Resolver.
+    std::vector<UpvalueSource> m_Upvalues;
+    std::vector<int> m_CapturedParams;
+    // Slots its frame needs for the parameters and every local of its blocks.
+    int m_FrameSize = 0;
+    // What calling it can do, filled in by the EffectAnalyzer. Effectful until that has run.
+    Effect m_Effect = EFFECT_EFFECTFUL;
+    // The first thing calling it does that writes state other code can see, as for Function.
+    std::string m_SharedWrite;
 
     AnonFunction(std::vector<Token> params, std::vector<UniqueStmtPtr> body)
             : m_Params(std::move(params)), m_Body(std::move(body)) {}
@@ -124,9 +177,16 @@ public:
     /*Token of the identifier of the field being accessed. If the parsed code were 'obj.a' then this variable would contain
      * the token corresponding to 'a' */
     Token m_Name;
+    SymbolId m_NameId;
+
+    /* Method cache of this property access, filled in by the interpreter: the id of the class the last method was
+     * found in and the (unbound) method itself. The next read on an instance of the same class that isn't shadowed by
+     * a field reuses it without touching the method table. */
+    uint32_t m_CachedClassId = 0;
+    KarolaScriptFunction* m_CachedMethod = nullptr;
 
     Get(const Token& name, UniqueExprPtr object)
-            : m_Name(name), m_Object(std::move(object)) {}
+            : m_Object(std::move(object)), m_Name(name), m_NameId(symbols::intern(name.lexeme)) {}
 
     Object accept(ExprVisitor<Object>& visitor) override {
         return visitor.visitGetExpr(*this);
@@ -194,9 +254,23 @@ class Super : public Expr {
 public:
     Token m_Keyword;
     Token m_Method;
+    SymbolId m_MethodId;
+
+    // Methods always capture "super", so it's one of the upvalues of the function the expression is in. The receiver
+    // is either in slot 0 of the frame when the expression is directly in an instance method, or one of the function's
+    // upvalues, and neither is set in a static method. All set by the Resolver.
+    int m_Upvalue = -1;
+    bool m_InMethod = false;
+    int m_ThisUpvalue = -1;
+
+    /* The superclass the method was last resolved in and the (unbound) method found there. Filled in when the class
+     * containing this expression is defined, so it's normally never a miss; the id is still compared at runtime in case
+     * the same class declaration ran again with a different superclass. */
+    uint32_t m_CachedClassId = 0;
+    KarolaScriptFunction* m_CachedMethod = nullptr;
 
     Super(const Token& keyword, const Token& method)
-            : m_Keyword(keyword), m_Method(method) {
+            : m_Keyword(keyword), m_Method(method), m_MethodId(symbols::intern(method.lexeme)) {
     }
 
     Object accept(ExprVisitor<Object>& visitor) override {
@@ -207,6 +281,9 @@ public:
 class This : public Expr {
 public:
     Token m_Keyword;
+    // Index of "this" in the upvalues of a function nested in the method, set by the Resolver. -1 in the method itself,
+    // where "this" is always in slot 0 of the frame.
+    int m_Upvalue = -1;
 
     explicit This(const Token& keyword) : m_Keyword(keyword) {
     }
@@ -248,6 +325,14 @@ public:
 class Variable : public Expr {
 public:
     Token m_VariableName;
+    // Where the Resolver found the variable: slot in the current function's frame for a local of the function, index in
+    // the function's upvalues for a variable of an enclosing function, or index in the interpreter's GlobalTable for a
+    // global. The others are -1. `m_InCell` is set for a local that some nested function captures, which lives in a
+    // cell instead of its slot.
+    int m_Slot = -1;
+    int m_Upvalue = -1;
+    int m_GlobalIndex = -1;
+    bool m_InCell = false;
 
     explicit Variable(const Token& name)
                 : m_VariableName(name) {
@@ -256,4 +341,35 @@ public:
     Object accept(ExprVisitor<Object>& visitor) override {
         return visitor.visitVariableExpr(*this);
     }
+};
+
+// `spawn f(args)`: starts the call as a task on the TaskPool and evaluates to a future of its result.
+class Spawn : public Expr {
+public:
+    Token m_Keyword;
+    // Only its callee and arguments are evaluated, by the Spawn itself.
+    std::shared_ptr<Call> m_Call;
+
+    Spawn(const Token& keyword, std::shared_ptr<Call> call)
+            : m_Keyword(keyword), m_Call(std::move(call)) {
+    }
+
+    Object accept(ExprVisitor<Object>& visitor) override {
+        return visitor.visitSpawnExpr(*this);
+    }
+};
+
+// `await future`: the result of a spawned task, once it's done.
+class Await : public Expr {
+public:
+    Token m_Keyword;
+    UniqueExprPtr m_Future;
+
+    Await(const Token& keyword, UniqueExprPtr future)
+            : m_Keyword(keyword), m_Future(std::move(future)) {
+    }
+
+    Object accept(ExprVisitor<Object>& visitor) override {
+        return visitor.visitAwaitExpr(*this);
+    }
 };
\ No newline at end of file
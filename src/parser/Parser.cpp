@@ -1,5 +1,7 @@
 #include "Parser.h"
 
+#include <cmath>
+
 Token Parser::previous() {
     return tokens.at(current - 1);
 }
@@ -42,6 +44,7 @@ void Parser::synchronize() { //synchronizes the parser to the next statement whe
         if (previous().type == TOKEN_SEMICOLON) return;
 
         switch (peek().type) {
+            case TOKEN_AT:
             case TOKEN_CLAZZ:
             case TOKEN_FUNCT:
             case TOKEN_LET:
@@ -51,6 +54,8 @@ void Parser::synchronize() { //synchronizes the parser to the next statement whe
             case TOKEN_KONSOLE:
             case TOKEN_RETURN:
                 return; //found new statement;
+            default:
+                break;
         }
 
         advance(); //keep advancing until finding a new statement
@@ -204,6 +209,20 @@ UniqueExprPtr Parser::unary() {
         return std::make_unique<Unary>(operator_, std::move(right));
     }
 
+    if (match({TOKEN_AWAIT})) {
+        Token keyword = previous();
+        return std::make_unique<Await>(keyword, unary());
+    }
+
+    if (match({TOKEN_SPAWN})) {
+        Token keyword = previous();
+        std::shared_ptr<Call> callExpr = std::dynamic_pointer_cast<Call>(call());
+        if (callExpr == nullptr) {
+            throw error(keyword, "Expected a call after 'spawn'.");
+        }
+        return std::make_unique<Spawn>(keyword, std::move(callExpr));
+    }
+
     // this if block can probably go to primary() but checked first
     if (match({TOKEN_BANG_EQUAL, TOKEN_EQUAL_EQUAL, TOKEN_GREATER,
                TOKEN_GREATER_EQUAL, TOKEN_LESS, TOKEN_LESS_EQUAL,
@@ -288,7 +307,7 @@ UniqueExprPtr Parser::primary() {
     }
 
     if (match({ TOKEN_NUMBER })) {
-        return std::make_unique<Literal>(Object(std::strtod(previous().lexeme.c_str(), nullptr)));
+        return std::make_unique<Literal>(Object::Number(previous().number));
     }
     if (match({ TOKEN_STRING })) {
         return std::make_unique<Literal>(Object(previous().lexeme));
@@ -476,7 +495,7 @@ UniqueStmtPtr Parser::letDeclaration() {
     return var;
 }
 
-std::unique_ptr<Function> Parser::function(const std::string& kind) {
+std::unique_ptr<Function> Parser::function(const std::string& kind, size_t memoCapacity) {
     Token name = consume(TOKEN_IDENTIFIER, "Expected " + kind + " name.");
     consume(TOKEN_LEFT_PAREN, "Expected '(' after " + kind + " name.");
 
@@ -494,7 +513,31 @@ std::unique_ptr<Function> Parser::function(const std::string& kind) {
     consume(TOKEN_LEFT_BRACE, "Expected '{' before " + kind + " body.");
 
     std::vector<UniqueStmtPtr> body = block();
-    return std::make_unique<Function>(name, parameters, std::move(body));
+    auto function = std::make_unique<Function>(name, parameters, std::move(body));
+    function->m_MemoCapacity = memoCapacity;
+    return function;
+}
+
+// `@memo funct ...` or `@memo(capacity) funct ...`, the only annotation there is so far.
+UniqueStmtPtr Parser::annotatedDeclaration() {
+    Token annotation = consume(TOKEN_IDENTIFIER, "Expected annotation name after '@'.");
+    if (annotation.lexeme != "memo") {
+        throw error(annotation, "Unknown annotation '" + annotation.lexeme + "'.");
+    }
+
+    size_t capacity = DEFAULT_MEMO_CAPACITY;
+    if (match({TOKEN_LEFT_PAREN})) {
+        Token size = consume(TOKEN_NUMBER, "Expected cache size after '@memo('.");
+        // Checked while still a double, since converting one out of range is undefined.
+        if (!(size.number >= 1 && size.number <= MAX_MEMO_CAPACITY) || std::trunc(size.number) != size.number) {
+            throw error(size, "Cache size has to be a positive integer no larger than 2^53.");
+        }
+        capacity = static_cast<size_t>(size.number);
+        consume(TOKEN_RIGHT_PAREN, "Expected ')' after cache size.");
+    }
+
+    consume(TOKEN_FUNCT, "Expected function declaration after '@memo'.");
+    return function("function", capacity);
 }
 
 UniqueStmtPtr Parser::clazzDeclaration() {
@@ -532,6 +575,8 @@ UniqueStmtPtr Parser::declaration() {
             return letDeclaration();
         if (match({TokenType::TOKEN_FUNCT}))
             return function("function");
+        if (match({TokenType::TOKEN_AT}))
+            return annotatedDeclaration();
 
         return statement();
     }
@@ -17,6 +17,11 @@ private:
     std::vector<Token> tokens;
     int current = 0; // next token eagerly waiting to be parsed  ---> currently considered token
 
+    // Results a `@memo` function caches when the annotation doesn't give a size.
+    static constexpr size_t DEFAULT_MEMO_CAPACITY = 1024;
+    // The largest size `@memo(size)` takes: past 2^53 not every integer is a number literal.
+    static constexpr double MAX_MEMO_CAPACITY = 9007199254740992.0;
+
     class ParseError : public std::runtime_error
     {
         public:
@@ -60,7 +65,8 @@ private:
     UniqueStmtPtr expressionStatement();
     UniqueStmtPtr statement();
     UniqueStmtPtr letDeclaration();
-    std::unique_ptr<Function> function(const std::string& kind);
+    std::unique_ptr<Function> function(const std::string& kind, size_t memoCapacity = 0);
+    UniqueStmtPtr annotatedDeclaration();
     UniqueStmtPtr clazzDeclaration();
     UniqueStmtPtr declaration();
 
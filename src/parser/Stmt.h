@@ -20,6 +20,12 @@ class Let;
 class While;
 class Break;
 
+class Stmt;
+class Interpreter;
+
+// Execution routine specialized for one node, installed by the ClosureCompiler.
+using StmtHandler = void (*)(Interpreter& interpreter, Stmt& stmt);
+
 class StmtVisitor {
 public:
     virtual ~StmtVisitor() = default;
@@ -37,6 +43,9 @@ public:
 
 class Stmt {
 public:
+    // When set, Interpreter::execute calls this directly instead of dispatching through accept().
+    StmtHandler m_Handler = nullptr;
+
     virtual ~Stmt() = default;
     virtual void accept(StmtVisitor& visitor) = 0;
 };
@@ -60,6 +69,16 @@ public:
     std::optional<std::unique_ptr<Variable>> m_Superclass; //Superclass is a Variable expression instead of a Token because the resolver needs to resolve the superclass and it needs an expr to do so.
     std::vector<std::unique_ptr<Function>> m_Methods;
     std::vector<std::unique_ptr<Function>> m_StaticMethods;
+    // Every `super.method` expression in the class' methods, collected by the Resolver.
+    std::vector<Super*> m_SuperExprs;
+    // Slot "super" gets in the frame the class is declared in, when there is a superclass.
+    int m_SuperSlot = -1;
+    // Slot the Resolver gave the declared name in its scope, or its index in the interpreter's GlobalTable for a
+    // top-level declaration. The other one is -1.
+    int m_Slot = -1;
+    int m_GlobalIndex = -1;
+    // Set by the Resolver when a nested function captures the declared name, which is then declared in a cell.
+    bool m_IsCaptured = false;
 
     Class(const Token& name, std::optional<std::unique_ptr<Variable>> superclass, std::vector<std::unique_ptr<Function>> methods, std::vector<std::unique_ptr<Function>> staticMethods)
             : m_Name(name), m_Superclass(std::move(superclass)), m_Methods(std::move(methods)), m_StaticMethods(std::move(staticMethods)) {
@@ -86,6 +105,25 @@ public:
     Token m_Name;
     std::vector<Token> m_Params;
     std::vector<UniqueStmtPtr> m_Body;
+    // Slot the Resolver gave the declared name in its scope, or its index in the interpreter's GlobalTable for a
+    // top-level declaration. The other one is -1.
+    int m_Slot = -1;
+    int m_GlobalIndex = -1;
+    // Set by the Resolver when a nested function captures the declared name, which is then declared in a cell.
+    bool m_IsCaptured = false;
+    // Variables of enclosing functions this one uses, in upvalue order, and the slots of its parameters that nested
+    // functions capture in turn. Both filled in by the Resolver.
+    std::vector<UpvalueSource> m_Upvalues;
+    std::vector<int> m_CapturedParams;
+    // Slots its frame needs for "this", the parameters and every local of its blocks.
+    int m_FrameSize = 0;
+    // Set by a `@memo` annotation: how many results the function caches (see MemoCache). 0 if it isn't memoized.
+    size_t m_MemoCapacity = 0;
+    // What calling it can do, filled in by the EffectAnalyzer. Effectful until that has run.
+    Effect m_Effect = EFFECT_EFFECTFUL;
+    // The first thing calling it does that writes state other code can see (e.g. "it assigns total"), filled in by
+    // the EffectAnalyzer. Empty if it writes no such state.
+    std::string m_SharedWrite;
 
     Function(const Token& name, const std::vector<Token>& params, std::vector<UniqueStmtPtr> body)
                 : m_Name(name), m_Params(params), m_Body(std::move(body)) {
@@ -142,6 +180,16 @@ class Let : public Stmt {
 public:
     Token m_Name;
     std::optional<UniqueExprPtr> m_Initializer; // Optional because you may declare a variable without initializing it.
+    // Slot the Resolver gave the declared name in its scope, or its index in the interpreter's GlobalTable for a
+    // top-level declaration. The other one is -1.
+    int m_Slot = -1;
+    int m_GlobalIndex = -1;
+    // Set by the Resolver when a nested function captures the declared name, which is then declared in a cell.
+    bool m_IsCaptured = false;
+    // Set by the EscapeAnalyzer when the initializer is a call whose instance never leaves the frame. The slot is
+    // cleared before the initializer runs, so the instance the previous run of the declaration left in it (e.g. in the
+    // last loop iteration) can be recycled.
+    bool m_NonEscaping = false;
 
     Let(const Token& name, std::optional<UniqueExprPtr> initializer)
         : m_Name(name), m_Initializer(std::move(initializer)) {
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+
+/* Whether script code can be running on more than one thread right now (see TaskPool).
+ *
+ * The interpreter fills caches as it runs without any synchronization: the ones in AST nodes (a call site's callee, a
+ * property access's method) and the ones in values (a string growing its buffer in place, a call site recycling its
+ * instance). While tasks are running those are only read, never filled: every thread takes the uncached path instead,
+ * and concatenation always copies. Fields of instances are locked while tasks are running (see KarolaScriptInstance),
+ * although a spawned task only reaches copies of what the code that started it can change (see MessageCopier).
+ * */
+namespace concurrency {
+    inline std::atomic<int> runningTasks{0};
+
+    inline bool active() {
+        // Acquire, so a thread that sees the last task finish also sees everything it did.
+        return runningTasks.load(std::memory_order_acquire) != 0;
+    }
+
+    // Counts as a running task for as long as it lives. Has to be created before the task is handed to another thread.
+    class TaskScope {
+    public:
+        TaskScope() { runningTasks.fetch_add(1, std::memory_order_relaxed); }
+        ~TaskScope() { runningTasks.fetch_sub(1, std::memory_order_release); }
+
+        TaskScope(const TaskScope&) = delete;
+        TaskScope& operator=(const TaskScope&) = delete;
+    };
+}
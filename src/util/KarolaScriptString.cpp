@@ -0,0 +1,79 @@
+#include "KarolaScriptString.h"
+
+#include <utility>
+
+#include "Concurrency.h"
+
+KarolaScriptString::KarolaScriptString(std::string_view chars) : m_Size(static_cast<uint32_t>(chars.size())) {
+    if (isInline()) {
+        chars.copy(m_Inline, chars.size());
+    } else {
+        m_Buffer = new Buffer();
+        m_Buffer->chars.assign(chars);
+    }
+}
+
+void KarolaScriptString::release() {
+    if (!isInline() && m_Buffer->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete m_Buffer;
+    }
+}
+
+KarolaScriptString KarolaScriptString::adopt(std::string&& chars) {
+    KarolaScriptString result;
+    result.m_Size = static_cast<uint32_t>(chars.size());
+    result.m_Buffer = new Buffer();
+    result.m_Buffer->chars = std::move(chars);
+    return result;
+}
+
+// 32-bit FNV-1a. 0 is reserved for "not computed yet".
+uint32_t KarolaScriptString::computeHash(std::string_view chars) {
+    uint32_t hash = 2166136261u;
+    for (char c : chars) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+KarolaScriptString KarolaScriptString::concat(const KarolaScriptString& left, std::string_view right) {
+    size_t size = left.size() + right.size();
+    if (size <= INLINE_CAPACITY) {
+        KarolaScriptString result;
+        result.m_Size = static_cast<uint32_t>(size);
+        left.view().copy(result.m_Inline, left.size());
+        right.copy(result.m_Inline + left.size(), right.size());
+        return result;
+    }
+
+    if (left.isInline()) {
+        std::string chars;
+        chars.reserve(size);
+        chars.append(left.view()).append(right);
+        return adopt(std::move(chars));
+    }
+
+    // Another thread may be reading the buffer, and growing it could move its bytes (see Concurrency.h).
+    std::string& chars = left.m_Buffer->chars;
+    if (left.m_Size == chars.size() && !concurrency::active()) {
+        // Nothing views the buffer past `left`, so it can grow in place. `right` may point into the same buffer
+        // (`s + s`), in which case growing it would move the bytes being appended, so copy those first.
+        if (right.data() >= chars.data() && right.data() < chars.data() + chars.capacity()) {
+            chars.append(std::string(right));
+        } else {
+            chars.append(right);
+        }
+
+        KarolaScriptString result;
+        result.m_Size = static_cast<uint32_t>(size);
+        result.m_Buffer = left.m_Buffer;
+        result.retain();
+        return result;
+    }
+
+    std::string copy;
+    copy.reserve(size);
+    copy.append(left.view()).append(right);
+    return adopt(std::move(copy));
+}
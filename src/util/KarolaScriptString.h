@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/* Immutable string value held by Object.
+ *
+ * Strings of up to INLINE_CAPACITY bytes are stored inline, so copying them never touches the heap. Longer strings
+ * view a prefix of a refcounted Buffer, and copying one only bumps the refcount.
+ *
+ * A Buffer is append-only and can be shared by several strings of different lengths. Concatenating onto a string
+ * that views the whole buffer appends to the buffer in place instead of copying it, so a loop doing `s = s + x`
+ * appends to one buffer (with std::string's amortized growth) instead of copying `s` on every iteration. Every other
+ * string that views the buffer still sees its own prefix, which nothing ever writes to again. While script code runs
+ * on more than one thread, concatenation always copies instead.
+ *
+ * The hash is computed on first use and cached in the value, so it is carried along by copies.
+ * */
+class KarolaScriptString {
+public:
+    static constexpr uint32_t INLINE_CAPACITY = 16;
+private:
+    struct Buffer {
+        std::atomic<uint32_t> refCount{1};
+        std::string chars;
+    };
+
+    union {
+        char m_Inline[INLINE_CAPACITY] = {};
+        Buffer* m_Buffer;
+    };
+    uint32_t m_Size = 0;
+    mutable uint32_t m_Hash = 0; // 0 until computed
+
+    bool isInline() const {
+        return m_Size <= INLINE_CAPACITY;
+    }
+
+    void retain() const {
+        if (!isInline()) {
+            m_Buffer->refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release();
+
+    static uint32_t computeHash(std::string_view chars);
+
+    // Takes over `chars`, which has to be longer than INLINE_CAPACITY, as the buffer of a new string.
+    static KarolaScriptString adopt(std::string&& chars);
+public:
+    KarolaScriptString() = default;
+
+    explicit KarolaScriptString(std::string_view chars);
+
+    KarolaScriptString(const KarolaScriptString& other) : m_Size(other.m_Size), m_Hash(other.m_Hash) {
+        if (other.isInline()) {
+            std::copy(other.m_Inline, other.m_Inline + INLINE_CAPACITY, m_Inline);
+        } else {
+            m_Buffer = other.m_Buffer;
+            retain();
+        }
+    }
+
+    KarolaScriptString(KarolaScriptString&& other) noexcept : m_Size(other.m_Size), m_Hash(other.m_Hash) {
+        if (other.isInline()) {
+            std::copy(other.m_Inline, other.m_Inline + INLINE_CAPACITY, m_Inline);
+        } else {
+            m_Buffer = other.m_Buffer;
+            other.m_Size = 0;
+            other.m_Hash = 0;
+        }
+    }
+
+    KarolaScriptString& operator=(const KarolaScriptString& other) {
+        if (this != &other) {
+            other.retain();
+            release();
+            m_Size = other.m_Size;
+            m_Hash = other.m_Hash;
+            if (other.isInline()) {
+                std::copy(other.m_Inline, other.m_Inline + INLINE_CAPACITY, m_Inline);
+            } else {
+                m_Buffer = other.m_Buffer;
+            }
+        }
+        return *this;
+    }
+
+    KarolaScriptString& operator=(KarolaScriptString&& other) noexcept {
+        if (this != &other) {
+            release();
+            m_Size = other.m_Size;
+            m_Hash = other.m_Hash;
+            if (other.isInline()) {
+                std::copy(other.m_Inline, other.m_Inline + INLINE_CAPACITY, m_Inline);
+            } else {
+                m_Buffer = other.m_Buffer;
+                other.m_Size = 0;
+                other.m_Hash = 0;
+            }
+        }
+        return *this;
+    }
+
+    ~KarolaScriptString() {
+        release();
+    }
+
+    // `left` followed by `right`. Appends to left's buffer in place when left is the only string that reaches its end.
+    static KarolaScriptString concat(const KarolaScriptString& left, std::string_view right);
+
+    size_t size() const {
+        return m_Size;
+    }
+
+    const char* data() const {
+        return isInline() ? m_Inline : m_Buffer->chars.data();
+    }
+
+    std::string_view view() const {
+        return {data(), m_Size};
+    }
+
+    std::string str() const {
+        return std::string(view());
+    }
+
+    uint32_t hash() const {
+        if (m_Hash == 0) {
+            m_Hash = computeHash(view());
+        }
+        return m_Hash;
+    }
+
+    bool operator==(const KarolaScriptString& other) const {
+        if (m_Size != other.m_Size) {
+            return false;
+        }
+        if (m_Hash != 0 && other.m_Hash != 0 && m_Hash != other.m_Hash) {
+            return false;
+        }
+        return view() == other.view();
+    }
+
+    bool operator!=(const KarolaScriptString& other) const {
+        return !(*this == other);
+    }
+};
@@ -12,8 +12,7 @@
 Object::Object(const Token &token) {
     switch (token.type) {
         case TOKEN_NUMBER:
-            type = ObjType::OBJTYPE_NUMBER;
-            number = std::stod(token.lexeme);
+            *this = Number(token.number);
             break;
         case TOKEN_TRUE:
             type = ObjType::OBJTYPE_BOOL;
@@ -25,7 +24,7 @@ Object::Object(const Token &token) {
             break;
         case TOKEN_STRING:
             type = ObjType::OBJTYPE_STRING;
-            str = token.lexeme;
+            str = KarolaScriptString(token.lexeme);
             break;
         case TOKEN_NULL:
             type = ObjType::OBJTYPE_NULL;
@@ -37,9 +36,11 @@ Object::Object(const Token &token) {
 
 Object::Object(double number) : type(ObjType::OBJTYPE_NUMBER), number(number) {}
 
-Object::Object(const std::string &string) : type(ObjType::OBJTYPE_STRING), str(string) {}
+Object::Object(const std::string &string) : str(string), type(ObjType::OBJTYPE_STRING) {}
 
-Object::Object(const char* string) : Object(std::string(string)) {}
+Object::Object(const char* string) : str(string), type(ObjType::OBJTYPE_STRING) {}
+
+Object::Object(KarolaScriptString string) : str(std::move(string)), type(ObjType::OBJTYPE_STRING) {}
 
 Object::Object(bool boolean) : type(ObjType::OBJTYPE_BOOL), boolean(boolean) {}
 
@@ -47,16 +48,25 @@ Object::Object(SharedCallablePtr callable) : type(ObjType::OBJTYPE_CALLABLE), ca
 
 Object::Object(SharedInstancePtr instance) : type(ObjType::OBJTYPE_INSTANCE), instance(std::move(instance)) {}
 
+Object::Object(SharedFuturePtr future) : future(std::move(future)), type(ObjType::OBJTYPE_FUTURE) {}
+
 Object Object::Null() {
     return Object();
 }
 
-Object::Object() : type(ObjType::OBJTYPE_NULL) {} //Initializes the object as NULL
-
-bool Object::isNumber() const {
-    return type == ObjType::OBJTYPE_NUMBER;
+Object Object::Number(double number) {
+    // Range check first, the cast is undefined for values outside of int32 (and NaN). -0 has to stay a double.
+    if (number >= INT32_MIN && number <= INT32_MAX) {
+        auto integer = static_cast<int32_t>(number);
+        if (integer == number && (integer != 0 || !std::signbit(number))) {
+            return Integer(integer);
+        }
+    }
+    return Object(number);
 }
 
+Object::Object() : type(ObjType::OBJTYPE_NULL) {} //Initializes the object as NULL
+
 bool Object::isBoolean() const {
     return type == ObjType::OBJTYPE_BOOL;
 }
@@ -81,6 +91,10 @@ bool Object::isInstance() const {
     return type == ObjType::OBJTYPE_INSTANCE;
 }
 
+bool Object::isFuture() const {
+    return type == ObjType::OBJTYPE_FUTURE;
+}
+
 double Object::getNumber() const {
     if (!isNumber()){
         throw std::runtime_error("Object does not contain a number");
@@ -95,7 +109,7 @@ bool Object::getBoolean() const {
     return boolean;
 }
 
-std::string Object::getString() const {
+const KarolaScriptString& Object::getString() const {
     if (!isString()){
         throw std::runtime_error("Object does not contain a string");
     }
@@ -114,4 +128,11 @@ SharedInstancePtr Object::getClassInstance() const {
         throw std::runtime_error("Object does not contain a class instance");
     }
     return instance;
+}
+
+SharedFuturePtr Object::getFuture() const {
+    if (!isFuture()){
+        throw std::runtime_error("Object does not contain a future");
+    }
+    return future;
 }
\ No newline at end of file
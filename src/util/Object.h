@@ -1,15 +1,20 @@
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
+#include <stdexcept>
 #include <string>
 
+#include "KarolaScriptString.h"
+
 enum ObjType {
-    OBJTYPE_NULL, OBJTYPE_BOOL, OBJTYPE_NUMBER, OBJTYPE_STRING, OBJTYPE_CALLABLE, OBJTYPE_CLASS, OBJTYPE_ANONFUNCTION, OBJTYPE_FUNCTION, OBJTYPE_INSTANCE
+    OBJTYPE_NULL, OBJTYPE_BOOL, OBJTYPE_NUMBER, OBJTYPE_INTEGER, OBJTYPE_STRING, OBJTYPE_CALLABLE, OBJTYPE_CLASS, OBJTYPE_ANONFUNCTION, OBJTYPE_FUNCTION, OBJTYPE_INSTANCE, OBJTYPE_FUTURE
 };
 
 class KarolaScriptCallable;
 class KarolaScriptInstance;
+class KarolaScriptFuture;
 
 struct Token;
 
@@ -18,6 +23,7 @@ struct Token;
  * */
 using SharedCallablePtr = std::shared_ptr<KarolaScriptCallable>;
 using SharedInstancePtr = std::shared_ptr<KarolaScriptInstance>;
+using SharedFuturePtr = std::shared_ptr<KarolaScriptFuture>;
 
 /* Object class is used to represent variables, instances, functions, classes, etc, essentially surrendering type safety
  * and having to depend on instanceof checks. I attempted to maintain some type safety with this class.
@@ -28,9 +34,11 @@ class Object {
 private:
     double number = 0.0;
     bool boolean = false;
-    std::string str;
+    int32_t integer = 0;
+    KarolaScriptString str;
     SharedCallablePtr callable;
     SharedInstancePtr instance;
+    SharedFuturePtr future;
 public:
     ObjType type = ObjType::OBJTYPE_NULL;
 
@@ -42,6 +50,8 @@ public:
 
     explicit Object(const char* string);
 
+    explicit Object(KarolaScriptString string);
+
     explicit Object(bool boolean);
 
     explicit Object(SharedCallablePtr callable);
@@ -52,11 +62,34 @@ public:
 
     explicit Object(KarolaScriptInstance* ptr) = delete;
 
+    explicit Object(SharedFuturePtr future);
+
     static Object Null();
 
+    /* Numbers that are small integers are kept as an int32 as well (OBJTYPE_INTEGER), so counters and comparisons
+     * between them don't go through floating point. It's only a representation: isNumber() is true for both, and
+     * getNumber() returns the same double either way. Number() picks the representation for a value, Integer() is for
+     * callers that already have an int32.
+     * */
+    static Object Number(double number);
+
+    static Object Integer(int32_t integer) {
+        Object object;
+        object.type = ObjType::OBJTYPE_INTEGER;
+        object.number = integer;
+        object.integer = integer;
+        return object;
+    }
+
     Object(); //Initializes the object as NULL
 
-    bool isNumber() const;
+    bool isNumber() const {
+        return type == ObjType::OBJTYPE_NUMBER || type == ObjType::OBJTYPE_INTEGER;
+    }
+
+    bool isInteger() const {
+        return type == ObjType::OBJTYPE_INTEGER;
+    }
 
     bool isBoolean() const;
 
@@ -70,13 +103,24 @@ public:
 
     bool isInstance() const;
 
+    bool isFuture() const;
+
     double getNumber() const;
 
+    int32_t getInteger() const {
+        if (!isInteger()){
+            throw std::runtime_error("Object does not contain an integer");
+        }
+        return integer;
+    }
+
     bool getBoolean() const;
 
-    std::string getString() const;
+    const KarolaScriptString& getString() const;
 
     SharedCallablePtr getCallable() const;
 
     SharedInstancePtr getClassInstance() const;
+
+    SharedFuturePtr getFuture() const;
 };
\ No newline at end of file
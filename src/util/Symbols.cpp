@@ -0,0 +1,45 @@
+#include "Symbols.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+    std::unordered_map<std::string, SymbolId>& table() {
+        static std::unordered_map<std::string, SymbolId> symbolTable;
+        return symbolTable;
+    }
+
+    // Names are also interned by classes created on worker threads (see TaskPool).
+    std::mutex& tableMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+}
+
+SymbolId symbols::intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(tableMutex());
+    auto& symbolTable = table();
+    auto found = symbolTable.find(name);
+    if (found != symbolTable.end()) {
+        return found->second;
+    }
+
+    auto id = static_cast<SymbolId>(symbolTable.size());
+    symbolTable.emplace(name, id);
+    return id;
+}
+
+std::optional<SymbolId> symbols::find(const std::string& name) {
+    std::lock_guard<std::mutex> lock(tableMutex());
+    auto& symbolTable = table();
+    auto found = symbolTable.find(name);
+    if (found == symbolTable.end()) {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+size_t symbols::count() {
+    std::lock_guard<std::mutex> lock(tableMutex());
+    return table().size();
+}
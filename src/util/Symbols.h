@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+using SymbolId = uint32_t;
+
+/* Interns identifiers into small dense integers. Method and property names are interned once (by the Parser for
+ * property accesses, and when a class is created for its methods) so method tables can be plain vectors indexed by
+ * SymbolId instead of maps keyed by the name.
+ * */
+namespace symbols {
+    SymbolId intern(const std::string& name);
+
+    // Returns the id of `name` if it has been interned, without interning it.
+    std::optional<SymbolId> find(const std::string& name);
+
+    // Number of interned symbols, i.e. one past the largest SymbolId handed out so far.
+    size_t count();
+}
@@ -1,4 +1,7 @@
 #include "Utils.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <cstddef>
 
 //Changes every occurrence of `from` into `to`
@@ -15,4 +18,36 @@ bool utils::endsWith(const std::string& str, const std::string& suffix) {
         return false;
     }
     return str.substr(str.length() - suffix.length()) == suffix;
-}
\ No newline at end of file
+}
+
+std::string_view utils::formatNumber(double number, NumberBuffer& buffer) {
+    char* first = buffer.data();
+    char* last = first + buffer.size();
+
+    // Also catches -0, which would otherwise be printed as "-0".
+    if (number == 0) {
+        *first = '0';
+        return {first, 1};
+    }
+
+    double magnitude = std::fabs(number);
+    if (magnitude >= 1e-7 && magnitude < 1e21) {
+        char* end = std::to_chars(first, last, number, std::chars_format::fixed).ptr;
+        return {first, static_cast<size_t>(end - first)};
+    }
+
+    char* end = std::to_chars(first, last, number, std::chars_format::scientific).ptr;
+    // The exponent comes with at least two digits, "2.5e-08", which is shortened to "2.5e-8".
+    char* exponent = std::find(first, end, 'e') + 2;
+    char* digits = exponent;
+    while (*digits == '0' && digits + 1 < end) {
+        digits++;
+    }
+    end = std::copy(digits, end, exponent);
+    return {first, static_cast<size_t>(end - first)};
+}
+
+std::string utils::numberToString(double number) {
+    NumberBuffer buffer;
+    return std::string(formatNumber(number, buffer));
+}
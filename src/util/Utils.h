@@ -1,8 +1,24 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
 
 namespace utils {
     void replaceAll(std::string &str, const std::string& from, const std::string& to);
     bool endsWith(const std::string& str, const std::string& suffix);
+
+    // Big enough for any number formatNumber writes.
+    using NumberBuffer = std::array<char, 32>;
+
+    /* Formats a number the way KarolaScript prints it: with the fewest digits that still read back as the same double,
+     * e.g. 0.1 is "0.1", 1/3 is "0.3333333333333333" and integers have no fractional part. Magnitudes from 1e-7 up to
+     * 1e21 are written out in full, e.g. 0.0001 is "0.0001", and anything outside that range in exponent notation,
+     * e.g. "1e+21" and "2.5e-8". Writes into `buffer` and returns the written part, so callers that only append the
+     * digits somewhere don't allocate.
+     * Used by both the interpreter and codegen so they agree on how a number looks as a string.
+     * */
+    std::string_view formatNumber(double number, NumberBuffer& buffer);
+
+    std::string numberToString(double number);
 }
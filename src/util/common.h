@@ -1,7 +1,34 @@
+#pragma once
+
 #include <memory>
 
 class Expr;
 class Stmt;
 
 using UniqueExprPtr = std::shared_ptr<Expr>;
-using UniqueStmtPtr = std::shared_ptr<Stmt>;
\ No newline at end of file
+using UniqueStmtPtr = std::shared_ptr<Stmt>;
+
+/* Where a function gets one of the variables it captures from when the function object is created, worked out by the
+ * Resolver. Either the local in `slot` of the enclosing function's frame, or the enclosing function's own upvalue number
+ * `index`.
+ * */
+struct UpvalueSource {
+    bool isLocal;
+    // "this" and "super" can never be assigned, so they're copied into a cell of their own instead of shared.
+    bool byValue;
+    int slot;
+    int index;
+};
+
+/* What calling a function can do besides computing its result, worked out by the EffectAnalyzer. Ordered, so the effect
+ * of code that does several things is the greatest of them.
+ * */
+enum Effect {
+    // The result only depends on the arguments, and the call changes nothing.
+    EFFECT_PURE,
+    // The result can also depend on state that can change (globals, properties, captured variables), but the call
+    // changes nothing.
+    EFFECT_READ_ONLY,
+    // The call can change state or do I/O, or makes a call the analysis can't follow.
+    EFFECT_EFFECTFUL
+};